@@ -0,0 +1,373 @@
+/*
+ * Micro-benchmarks do escalonador e das primitivas de sincronização.
+ *
+ * Uso: bench [filtro]
+ * Executa os benchmarks cujo nome contém filtro (todos, sem filtro) e escreve na saída padrão um JSON com, para
+ * cada um, os percentis de ns/op das amostras (cada amostra é um lote de operações cronometrado de uma vez),
+ * para comparar versões. A configuração de Traits<Thread> em uso também vai no JSON.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Concurrency/system.h"
+#include "Concurrency/cpu.h"
+#include "Concurrency/thread.h"
+#include "Concurrency/semaphore.h"
+#include "Concurrency/barrier.h"
+#include "Concurrency/list.h"
+#include "Concurrency/trace.h"
+
+__USING_API
+
+static const int SAMPLES = 200; // amostras por benchmark.
+
+struct Result
+{
+    std::string name;
+    long long ops; // operações por amostra.
+    std::vector<double> samples; // ns/op de cada amostra.
+};
+
+static std::vector<Result> results;
+static const char * filter = 0;
+
+static long long now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static bool selected(const std::string & name)
+{
+    return !filter || name.find(filter) != std::string::npos;
+}
+
+static void record(const std::string & name, long long ops, const std::vector<double> & samples)
+{
+    Result r;
+    r.name = name;
+    r.ops = ops;
+    r.samples = samples;
+    results.push_back(r);
+}
+
+static double percentile(const std::vector<double> & sorted, double p)
+{
+    unsigned int i = (unsigned int)(p * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+static void report()
+{
+    printf("{\n  \"config\": {\"workers\": %u, \"preemptive\": %s, \"direct_switch\": %s, \"ready_heap\": %s, \"samples\": %d},\n",
+           Traits<Thread>::workers, Traits<Thread>::preemptive ? "true" : "false",
+           Traits<Thread>::direct_switch ? "true" : "false", Traits<Thread>::ready_heap ? "true" : "false", SAMPLES);
+    printf("  \"benchmarks\": [\n");
+    for (unsigned int i = 0; i < results.size(); i++)
+    {
+        std::vector<double> s = results[i].samples;
+        std::sort(s.begin(), s.end());
+        double mean = 0;
+        for (unsigned int j = 0; j < s.size(); j++)
+            mean += s[j];
+        mean /= s.size();
+
+        printf("    {\"name\": \"%s\", \"ops_per_sample\": %lld, \"ns_per_op\": "
+               "{\"min\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f, \"mean\": %.2f}}%s\n",
+               results[i].name.c_str(), results[i].ops,
+               s.front(), percentile(s, 0.5), percentile(s, 0.9), percentile(s, 0.99), s.back(), mean,
+               i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+// Troca de contexto crua (CPU::switch_context), fora do escalonador: ida e volta entre dois contextos.
+static CPU::Context * native;
+static CPU::Context * partner;
+
+static void bounce()
+{
+    for (;;)
+        CPU::switch_context(partner, native);
+}
+
+static void bench_switch_context()
+{
+    const std::string name = "cpu_switch_context";
+    if (!selected(name))
+        return;
+
+    const int K = 10000;
+    native = new CPU::Context();
+    partner = new CPU::Context(&bounce);
+
+    std::vector<double> samples;
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        long long t0 = now();
+        for (int k = 0; k < K; k++)
+            CPU::switch_context(native, partner);
+        samples.push_back(double(now() - t0) / (2 * K)); // duas trocas por volta.
+    }
+    record(name, 2 * K, samples);
+}
+
+// As threads dos benchmarks abaixo executam um lote por amostra entre duas passagens pela barreira, na qual
+// a thread que cronometra também espera (sem ocupar o processador enquanto o lote executa).
+static Barrier * barrier;
+static Semaphore * first;
+static Semaphore * second;
+static int batch;
+
+static void yielder(int)
+{
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        barrier->arrive_and_wait();
+        for (int k = 0; k < batch; k++)
+            Thread::yield();
+        barrier->arrive_and_wait();
+    }
+    Thread::running()->thread_exit(0);
+}
+
+// Thread 0 e thread 1 se alternam por dois semáforos.
+static void pingpong(int i)
+{
+    Semaphore * mine = i ? first : second;
+    Semaphore * other = i ? second : first;
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        barrier->arrive_and_wait();
+        for (int k = 0; k < batch; k++)
+        {
+            if (i)
+            {
+                mine->p();
+                other->v();
+            }
+            else
+            {
+                other->v();
+                mine->p();
+            }
+        }
+        barrier->arrive_and_wait();
+    }
+    Thread::running()->thread_exit(0);
+}
+
+static void contender(int)
+{
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        barrier->arrive_and_wait();
+        for (int k = 0; k < batch; k++)
+        {
+            // Cede o processador com o semáforo adquirido: as demais threads chegam ao p() com ele ocupado.
+            // Sem isso, com um worker e sem preempção, nenhuma thread encontra o semáforo em uso.
+            first->p();
+            Thread::yield();
+            first->v();
+        }
+        barrier->arrive_and_wait();
+    }
+    Thread::running()->thread_exit(0);
+}
+
+// Cria as n threads com entry, cronometra SAMPLES lotes de iterations iterações de cada e registra ns por
+// operação, com ops operações por lote.
+static void run_batches(const std::string & name, int n, void (* entry)(int), int iterations, long long ops)
+{
+    batch = iterations;
+    barrier = new Barrier(n + 1);
+
+    std::vector<Thread *> threads;
+    for (int i = 0; i < n; i++)
+        threads.push_back(new Thread(entry, i));
+
+    std::vector<double> samples;
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        // O início é marcado antes da barreira: a última thread a chegar nela pode executar o lote inteiro
+        // antes de a que cronometra voltar a executar.
+        long long t0 = now();
+        barrier->arrive_and_wait();
+        barrier->arrive_and_wait();
+        samples.push_back(double(now() - t0) / ops);
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+    delete barrier;
+
+    record(name, ops, samples);
+}
+
+static void bench_yield()
+{
+    const int sizes[] = { 2, 8, 64 };
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        std::string name = "thread_yield_" + std::to_string(sizes[i]);
+        if (selected(name))
+            run_batches(name, sizes[i], &yielder, 1000, sizes[i] * 1000LL);
+    }
+}
+
+static void bench_semaphore()
+{
+    if (selected("semaphore_pingpong"))
+    {
+        // Uma operação é uma volta completa (v e p de cada lado).
+        first = new Semaphore(0);
+        second = new Semaphore(0);
+        run_batches("semaphore_pingpong", 2, &pingpong, 1000, 1000);
+        delete first;
+        delete second;
+    }
+
+    const int sizes[] = { 1, 4, 16 };
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        std::string name = "semaphore_contended_" + std::to_string(sizes[i]);
+        if (!selected(name))
+            continue;
+        first = new Semaphore(1);
+        run_batches(name, sizes[i], &contender, 1000, sizes[i] * 1000LL); // uma operação é um par p/v (com um yield).
+        delete first;
+    }
+}
+
+static void nothing(int) { Thread::running()->thread_exit(0); }
+
+static void bench_create_join()
+{
+    const std::string name = "thread_create_join";
+    if (!selected(name))
+        return;
+
+    const int K = 100;
+    std::vector<double> samples;
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        long long t0 = now();
+        for (int k = 0; k < K; k++)
+        {
+            Thread * t = new Thread(&nothing, k);
+            t->join();
+            delete t;
+        }
+        samples.push_back(double(now() - t0) / K);
+    }
+    record(name, K, samples);
+}
+
+// Ordered_List com n elementos: cada operação retira a cabeça e insere um elemento com rank aleatório.
+struct Item
+{
+    Item(): link(this) {}
+
+    Ordered_List<Item>::Element link;
+};
+
+static void bench_ordered_list()
+{
+    const int sizes[] = { 16, 256, 4096 };
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        std::string name = "ordered_list_" + std::to_string(sizes[i]);
+        if (!selected(name))
+            continue;
+
+        const int K = 1000;
+        unsigned int seed = 1;
+        std::vector<Item> items(sizes[i]);
+        Ordered_List<Item> list;
+        for (int j = 0; j < sizes[i]; j++)
+        {
+            seed = seed * 1103515245 + 12345;
+            items[j].link.rank(seed >> 8);
+            list.insert(&items[j].link);
+        }
+
+        std::vector<double> samples;
+        for (int s = 0; s < SAMPLES; s++)
+        {
+            long long t0 = now();
+            for (int k = 0; k < K; k++)
+            {
+                Ordered_List<Item>::Element * e = list.remove();
+                seed = seed * 1103515245 + 12345;
+                e->rank(seed >> 8);
+                list.insert(e);
+            }
+            samples.push_back(double(now() - t0) / K);
+        }
+        record(name, K, samples);
+    }
+}
+
+// Custo de um ponto de rastreamento (só com Traits<Trace>::enabled).
+static void bench_trace()
+{
+    const std::string name = "trace_record";
+    if (!Trace::ENABLED || !selected(name))
+        return;
+
+    const int K = 10000;
+    std::vector<double> samples;
+    for (int s = 0; s < SAMPLES; s++)
+    {
+        long long t0 = now();
+        for (int k = 0; k < K; k++)
+            Trace::record(0, Trace::YIELD, s, k);
+        samples.push_back(double(now() - t0) / K);
+    }
+    record(name, K, samples);
+}
+
+static void body(int)
+{
+    bench_yield();
+    bench_semaphore();
+    bench_create_join();
+
+    Thread::int_disable();
+    report();
+    Thread::int_enable();
+
+    Thread::running()->thread_exit(0);
+}
+
+// A main não volta para a fila de prontos em yield(): os benchmarks executam em outra thread.
+static void bench_main(void *)
+{
+    Thread * t = new Thread(&body, 0);
+    t->join();
+    delete t;
+    Thread::running()->thread_exit(0);
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc > 1)
+        filter = argv[1];
+
+    // Fora do escalonador.
+    bench_switch_context();
+    bench_ordered_list();
+    bench_trace();
+
+    System::init(&bench_main);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef barrier_h
+#define barrier_h
+
+#include "Concurrency/thread.h"
+#include "Concurrency/traits.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/list.h"
+
+__BEGIN_API
+
+/*
+ * Barreira reutilizável para count threads: cada uma dorme em arrive_and_wait() até a última chegar,
+ * que acorda todas de uma vez e segue sem dormir (recebendo true). A barreira volta ao estado inicial
+ * para a fase seguinte.
+ */
+class Barrier
+{
+public:
+    typedef Ordered_List<Thread> Asleep_Queue;
+
+    Barrier(unsigned int count): _count(count), _arrived(0), _phase(0) {}
+    ~Barrier();
+
+    bool arrive_and_wait();
+
+    unsigned int phase() { return _phase; } // fases já completadas.
+
+private:
+    Asleep_Queue _asleep;
+    unsigned int _count;
+    unsigned int _arrived; // Protegido por Thread::lock(), assim como _phase.
+    volatile unsigned int _phase;
+};
+
+__END_API
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef channel_h
+#define channel_h
+
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "Concurrency/thread.h"
+#include "Concurrency/traits.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/list.h"
+
+__BEGIN_API
+
+class Select;
+
+/*
+ * Parte de Channel que não depende do tipo dos valores: as filas de threads esperando e o fechamento.
+ * Cada thread que espera tem um Waiter na sua pilha, com o endereço do valor que envia (remetente) ou de onde
+ * colocar o recebido (destinatário). Quem a tira da fila faz a transferência e zera item antes de acordá-la.
+ */
+class Channel_Common
+{
+    friend class Select;
+
+protected:
+    struct Waiter;
+    typedef List_Elements::Doubly_Linked_Ordered<Waiter> Waiter_Element;
+    typedef List<Waiter, Waiter_Element> Wait_List;
+
+    struct Waiter
+    {
+        Waiter(void * i = 0, Select * s = 0): thread(Thread::running()), item(i), link(this), select(s) {}
+
+        Thread * thread;
+        void * volatile item; // 0 quando a transferência foi feita por outra thread.
+        Waiter_Element link;
+        Select * select; // caso de um Select, que é acordado por Select::fire() em vez de wake().
+    };
+
+protected:
+    Channel_Common(): _closed(false) {}
+    ~Channel_Common();
+
+    // Com Thread::lock() adquirido: coloca a thread em execução em list e dorme até ser atendida (true) ou o
+    // canal ser fechado (false). Retorna sem a trava.
+    bool wait(Wait_List & list, Waiter * waiter);
+    // Com Thread::lock() adquirido: tira o primeiro de list, que deve ser atendido em seguida com done().
+    static Waiter * next(Wait_List & list) { return list.remove()->object(); }
+    static void done(Waiter * waiter) { waiter->item = 0; wake(waiter); }
+    static void wake(Waiter * waiter);
+
+    void shut(); // fecha o canal e acorda todos os que esperam, com Thread::lock() adquirido.
+
+protected:
+    Wait_List _senders; // esperam espaço no buffer (ou, sem buffer, um destinatário).
+    Wait_List _receivers; // esperam um valor; só há destinatários esperando com o buffer vazio.
+    volatile bool _closed;
+};
+
+/*
+ * Canal com buffer de N valores do tipo T entre quaisquer threads (MPMC), em ordem FIFO.
+ * send() dorme com o buffer cheio e recv() com ele vazio; try_send() e try_recv() devolvem false em vez de dormir.
+ * Os valores são movidos (não copiados) para o buffer circular, construídos no próprio espaço reservado.
+ * Com um destinatário esperando, send() move o valor diretamente para ele, sem passar pelo buffer; com N = 0,
+ * toda transferência é assim (encontro entre remetente e destinatário).
+ * Depois de close(), send() devolve false e recv() devolve os valores que restam no buffer e então false;
+ * quem está dormindo no canal acorda (remetentes sem entregar o valor).
+ */
+template<typename T, unsigned int N>
+class Channel: public Channel_Common
+{
+    friend class Select;
+
+public:
+    Channel(): _head(0), _size(0) {}
+    ~Channel() { while (_size) pop(); }
+
+    bool send(T && value) { return put(value, true); }
+    bool send(const T & value) { T v(value); return put(v, true); }
+    bool try_send(T && value) { return put(value, false); }
+    bool try_send(const T & value) { T v(value); return put(v, false); }
+
+    bool recv(T & value) { return get(value, true); }
+    bool try_recv(T & value) { return get(value, false); }
+
+    void close();
+
+    bool closed() { return _closed; }
+    unsigned int size() { return _size; }
+    static unsigned int capacity() { return N; }
+
+private:
+    bool put(T & value, bool block);
+    bool get(T & value, bool block);
+
+    // Transferência sem dormir, com Thread::lock() adquirido (também usadas por Select, com item do tipo T).
+    bool give(T & value);
+    bool take(T & value);
+    static bool give(Channel_Common * channel, void * item) { return static_cast<Channel *>(channel)->give(*static_cast<T *>(item)); }
+    static bool take(Channel_Common * channel, void * item) { return static_cast<Channel *>(channel)->take(*static_cast<T *>(item)); }
+
+    T * slot(unsigned int i) { return reinterpret_cast<T *>(&_buffer[i % (N ? N : 1)]); }
+    void push(T & value) { new (slot(_head + _size)) T(std::move(value)); _size++; }
+    void pop() { slot(_head)->~T(); _head = (_head + 1) % (N ? N : 1); _size--; }
+
+private:
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type _buffer[N ? N : 1];
+    unsigned int _head; // Protegidos por Thread::lock(), assim como o conteúdo do buffer.
+    unsigned int _size;
+};
+
+template<typename T, unsigned int N>
+bool Channel<T, N>::put(T & value, bool block)
+{
+    db<Channel_Common>(TRC) << "Channel::send(block=" << block << ") called." << "\n";
+    Thread::int_disable();
+    Thread::lock();
+
+    bool sent = !_closed && give(value);
+    if (!sent && !_closed && block)
+    {
+        Waiter waiter(&value);
+        sent = wait(_senders, &waiter);
+        Thread::int_enable();
+        return sent;
+    }
+
+    Thread::unlock();
+    Thread::int_enable();
+    return sent;
+}
+
+template<typename T, unsigned int N>
+bool Channel<T, N>::give(T & value)
+{
+    if (!_receivers.empty())
+    {
+        // Entrega direta: o buffer está vazio e o destinatário recebe o valor no lugar onde espera.
+        Waiter * receiver = next(_receivers);
+        *static_cast<T *>(receiver->item) = std::move(value);
+        done(receiver);
+        return true;
+    }
+    if (_size < N)
+    {
+        push(value);
+        return true;
+    }
+    return false;
+}
+
+template<typename T, unsigned int N>
+bool Channel<T, N>::get(T & value, bool block)
+{
+    db<Channel_Common>(TRC) << "Channel::recv(block=" << block << ") called." << "\n";
+    Thread::int_disable();
+    Thread::lock();
+
+    bool received = take(value);
+    if (!received && !_closed && block)
+    {
+        Waiter waiter(&value);
+        received = wait(_receivers, &waiter);
+        Thread::int_enable();
+        return received;
+    }
+
+    Thread::unlock();
+    Thread::int_enable();
+    return received;
+}
+
+template<typename T, unsigned int N>
+bool Channel<T, N>::take(T & value)
+{
+    if (_size)
+    {
+        value = std::move(*slot(_head));
+        pop();
+        // O espaço liberado vai para o primeiro remetente esperando, que não precisa mais disputá-lo.
+        if (!_senders.empty())
+        {
+            Waiter * sender = next(_senders);
+            push(*static_cast<T *>(sender->item));
+            done(sender);
+        }
+        return true;
+    }
+    if (!_senders.empty())
+    {
+        // Sem buffer (N = 0): recebe diretamente do remetente.
+        Waiter * sender = next(_senders);
+        value = std::move(*static_cast<T *>(sender->item));
+        done(sender);
+        return true;
+    }
+    return false;
+}
+
+template<typename T, unsigned int N>
+void Channel<T, N>::close()
+{
+    db<Channel_Common>(TRC) << "Channel::close called." << "\n";
+    Thread::int_disable();
+    Thread::lock();
+    shut();
+    Thread::unlock();
+    Thread::int_enable();
+}
+
+__END_API
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef condition_h
+#define condition_h
+
+#include "Concurrency/thread.h"
+#include "Concurrency/mutex.h"
+#include "Concurrency/traits.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/list.h"
+
+__BEGIN_API
+
+/*
+ * Variável de condição, usada com um Mutex adquirido pela thread em execução.
+ * wait() libera o mutex e dorme atomicamente (um signal() entre os dois não se perde) e o readquire
+ * ao acordar. signal() e broadcast() só tornam as threads prontas, sem ceder o processador:
+ * broadcast() as move todas para a fila de prontos de uma vez, com uma única aquisição da trava.
+ */
+class Condition
+{
+public:
+    typedef Ordered_List<Thread> Asleep_Queue;
+
+    Condition() {}
+    ~Condition();
+
+    void wait(Mutex & mutex);
+    // wait() com prazo em microssegundos; devolve false se o prazo expirou (o mutex é readquirido mesmo assim).
+    bool wait(Mutex & mutex, const Thread::Microsecond & timeout);
+
+    void signal();
+    void broadcast();
+
+private:
+    bool sleep(Mutex & mutex, const Thread::Microsecond & deadline);
+
+private:
+    Asleep_Queue _asleep;
+};
+
+__END_API
+
+#endif
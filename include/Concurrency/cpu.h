@@ -3,7 +3,9 @@
 
 #include <ucontext.h>
 #include <iostream>
+#include <new>
 #include "traits.h"
+#include "stack_pool.h"
 
 __BEGIN_API
 
@@ -14,18 +16,38 @@ class CPU
         class Context
         {
         private:
-            static const unsigned int STACK_SIZE = Traits<CPU>::STACK_SIZE;
+            static const unsigned int STACK_SIZE = Stack_Pool::STACK_SIZE;
         public:
-            Context() { _stack = 0; };
+            // A troca de contexto em assembly só existe para x86-64 e AArch64.
+            // Nas demais arquiteturas, usa-se sempre o caminho com swapcontext.
+#if defined(__x86_64__) || defined(__aarch64__)
+            static const bool FAST_SWITCH = Traits<CPU>::fast_switch;
+#else
+            static const bool FAST_SWITCH = false;
+#endif
+
+            Context() { _stack = 0; _stack_size = 0; _sp = 0; };
+
+            template<typename ... Tn>
+            Context(void (* func)(Tn ...), Tn ... an) : Context(STACK_SIZE, func, an...) {}
 
+            // Cria o contexto com uma pilha de stack_size bytes no lugar de STACK_SIZE.
             template<typename ... Tn>
-            Context(void (* func)(Tn ...), Tn ... an) {
-                allocateStack(); // aloca espaço para a pilha do contexto.
+            Context(unsigned int stack_size, void (* func)(Tn ...), Tn ... an) {
+                allocateStack(stack_size); // aloca espaço para a pilha do contexto.
+
+                if (FAST_SWITCH) {
+                    // Monta no topo da pilha um quadro igual ao deixado por switch_context, de forma que
+                    // a primeira troca para este contexto "retorne" para um trampolim que chama func(an...).
+                    prepareStack([func, an...]() { func(an...); });
+                    return;
+                }
+
                 save(); // inicializa o contexto em _context. Que será usado no makecontext.
 
-                this->_context.uc_link = 0; // ponteiro ao contexto que seria carregado após o retorno do contexto atual. 
+                this->_context.uc_link = 0; // ponteiro ao contexto que seria carregado após o retorno do contexto atual.
                                             // porém, como não haverá tal retorno, esse valor é 0.
-                setContextStack(); 
+                setContextStack();
 
                 ucontext_t *newContextPtr =  &this->_context;
                 makecontext(newContextPtr, (void(*)())(func), sizeof...(Tn), an...); // Cria o novo contexto.
@@ -35,27 +57,76 @@ class CPU
 
             void save();
             void load();
+            void trim(); // devolve ao SO as páginas da pilha que o contexto salvo não está usando.
 
-        private:            
-            char *_stack;
+            unsigned int stack_size() const { return _stack_size; }
+            unsigned int stack_usage() const; // pico de uso da pilha (só disponível com Traits<Stack_Pool>::paint).
 
-            void allocateStack() {
-                    this->_stack = new char[STACK_SIZE];
+        private:
+            char *_stack;
+            unsigned int _stack_size;
+            void *_sp; // stack pointer salvo pela troca de contexto em assembly.
+
+            void allocateStack(unsigned int stack_size) {
+                    this->_stack_size = Stack_Pool::round(stack_size);
+                    this->_stack = Stack_Pool::alloc(this->_stack_size); // pilha com página de guarda, reaproveitada do pool quando possível.
+                    if (Stack_Pool::PAINT)
+                        Stack_Pool::paint(this->_stack, this->_stack_size);
                 }
 
             void setContextStack() {
                 this->_context.uc_stack.ss_flags = 0;
                 this->_context.uc_stack.ss_sp = this->_stack; // seta o stack pointer do contexto para a pilha alocada.
-                this->_context.uc_stack.ss_size = STACK_SIZE; // seta o tamanho da pilha do contexto.
+                this->_context.uc_stack.ss_size = this->_stack_size; // seta o tamanho da pilha do contexto.
+            }
+
+            // Copia o closure para o topo da pilha e monta o quadro inicial da troca de contexto abaixo dele.
+            template<typename F>
+            void prepareStack(const F & f) {
+                char *top = this->_stack + this->_stack_size - sizeof(F);
+                top = (char *)((unsigned long)top & ~15UL); // alinhamento de 16 bytes exigido pela ABI.
+                new (top) F(f);
+                this->_sp = prepareFrame(top, &launch<F>, top);
             }
 
+            template<typename F>
+            static void launch(void *closure) { (*reinterpret_cast<F *>(closure))(); }
+
+            static void *prepareFrame(char *top, void (*launch)(void *), void *closure);
+
+            friend class CPU;
+
         public:
             ucontext_t _context;
         };
 
     public:
-        static int finc(volatile int & number);
-        static int fdec(volatile int & number);
+        // Incremento e decremento atômicos (barreira completa, como o lock xadd): devolvem o valor anterior.
+        static int finc(volatile int & number) { return __atomic_fetch_add(&number, 1, __ATOMIC_SEQ_CST); }
+        static int fdec(volatile int & number) { return __atomic_fetch_add(&number, -1, __ATOMIC_SEQ_CST); }
+
+        // Test-and-set: escreve 1 em lock e devolve o valor anterior.
+        static int tsl(volatile int & lock) { return __atomic_exchange_n(&lock, 1, __ATOMIC_ACQUIRE); }
+        static void clear(volatile int & lock) { __atomic_store_n(&lock, 0, __ATOMIC_RELEASE); }
+
+        // Compare-and-swap: escreve replace se value == compare. Devolve o valor anterior.
+        static int cas(volatile int & value, int compare, int replace) {
+            __atomic_compare_exchange_n(&value, &compare, replace, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+            return compare;
+        }
+        // Escreve replace em value e devolve o valor anterior.
+        static int swap(volatile int & value, int replace) { return __atomic_exchange_n(&value, replace, __ATOMIC_ACQ_REL); }
+
+        // Dica ao processador de que o código está em espera ocupada.
+        static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+            asm volatile("pause" ::: "memory");
+#elif defined(__aarch64__)
+            asm volatile("yield" ::: "memory");
+#else
+            asm volatile("" ::: "memory");
+#endif
+        }
         static int switch_context(Context *from, Context *to);
 
 };
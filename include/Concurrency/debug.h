@@ -1,19 +1,42 @@
 #ifndef debug_h
 #define debug_h
 
-#include <iostream>
+#include <string.h>
+#include <type_traits>
 #include "traits.h"
 
 __BEGIN_API
 
+/*
+ * Saída de db<>(). Cada mensagem (uma expressão db<T>(l) << ... << ...) é formatada, sem alocação, no próprio
+ * objeto Debug (temporário na pilha da thread que escreve) e publicada ao fim da expressão, no destrutor.
+ * Com Traits<Debug>::asynchronous, a mensagem é copiada para uma fila circular sem trava, esvaziada por uma
+ * thread do kernel que escreve as mensagens acumuladas com um único writev(); quem escreve só faz uma
+ * chamada de sistema para acordá-la quando ela está ociosa. Mensagens de erro (ERR) são escritas antes de
+ * db<>() retornar, e as pendentes ao fim do processo (exit()). Sem asynchronous, cada mensagem é um write().
+ * A saída vai direto para Traits<Debug>::fd, sem passar pelo buffer de stdout/cout.
+ */
 class Debug {
 public:
+    Debug(): _length(0), _error(false) {}
+    ~Debug() { if (_length) publish(); }
+
+    Debug & operator<<(const char * s) { return text(s, strlen(s)); }
+    Debug & operator<<(char * s) { return text(s, strlen(s)); }
+    Debug & operator<<(char c) { return text(&c, 1); }
+    Debug & operator<<(double d);
+
     template<typename T>
-    Debug & operator<<(T p) { 
-        std::cout << p; 
-        return *this;
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, Debug &>::type
+    operator<<(T n) {
+        if (std::is_signed<T>::value && (long long)n < 0)
+            return number(0 - (unsigned long long)(long long)n, true);
+        return number((unsigned long long)n, false);
     }
 
+    template<typename T>
+    Debug & operator<<(T * p) { return pointer((const void *)p); }
+
     struct Begl {};
     struct Err {};
 
@@ -26,8 +49,48 @@ public:
         return *this;
     }
 
+    // Escreve as mensagens ainda na fila (chamado também ao fim do processo).
+    static void flush();
+
+private:
+    static const unsigned int BUFFER = Traits<Debug>::buffer;
+    static const unsigned int RECORDS = Traits<Debug>::records;
+    static const unsigned int BATCH = Traits<Debug>::batch;
+
+    // Posição da fila (fila limitada de Vyukov), com sequence relativo à volta da posição, lap(): livre para o
+    // produtor quando sequence == lap, pronta para o consumidor quando sequence == lap + 1. Começa toda zerada,
+    // sem inicialização que um produtor precise esperar.
+    struct Record
+    {
+        unsigned long sequence;
+        unsigned int length;
+        char text[BUFFER];
+    };
+
+    Debug & text(const char * s, unsigned int n);
+    Debug & number(unsigned long long n, bool negative);
+    Debug & pointer(const void * p);
+    void publish();
+
+    static bool enqueue(const char * text, unsigned int length);
+    static unsigned long lap(unsigned long position) { return position & ~(unsigned long)(RECORDS - 1); }
+    static bool drain(); // escreve um lote; false se a fila estava vazia.
+    static bool drain_all(bool wait); // esvazia a fila; sem wait, false se outra thread já o fazia ou não havia nada.
+    static void * drainer(void *);
+    static void start();
+
 private:
+    char _buffer[BUFFER];
+    unsigned int _length;
     volatile bool _error;
+
+    static Record _records[RECORDS];
+    alignas(64) static volatile unsigned long _tail; // próxima posição a preencher (produtores).
+    alignas(64) static volatile unsigned long _head; // próxima posição a escrever (consumidor).
+    static volatile int _draining; // trava de quem esvazia a fila (o drenador ou flush()).
+    static volatile int _idle; // o drenador dorme (futex) esperando mensagens.
+    static volatile int _started; // o drenador foi criado.
+
 public:
     static Begl begl;
     static Err error;
@@ -55,18 +118,21 @@ enum Debug_Error {ERR = 1};
 template<typename T>
 inline Select_Debug<(Traits<T>::debugged && Traits<Debug>::error)>
 db(Debug_Error l) {
-    Select_Debug<(Traits<T>::debugged && Traits<Debug>::error)>() << Debug::begl;
-    Select_Debug<(Traits<T>::debugged && Traits<Debug>::error)>() << Debug::error;
-    return Select_Debug<(Traits<T>::debugged && Traits<Debug>::error)>();
+    // A marca de erro vai no objeto devolvido, que escreve a mensagem.
+    Select_Debug<(Traits<T>::debugged && Traits<Debug>::error)> d;
+    d << Debug::begl;
+    d << Debug::error;
+    return d;
 }
 
 template<typename T1, typename T2>
 inline Select_Debug<((Traits<T1>::debugged || Traits<T2>::debugged) && Traits<Debug>::error)>
 db(Debug_Error l) {
 
-    Select_Debug<((Traits<T1>::debugged || Traits<T2>::debugged) && Traits<Debug>::error)>() << Debug::begl;
-    Select_Debug<((Traits<T1>::debugged || Traits<T2>::debugged) && Traits<Debug>::error)>() << Debug::error;
-    return Select_Debug<((Traits<T1>::debugged || Traits<T2>::debugged) && Traits<Debug>::error)>();
+    Select_Debug<((Traits<T1>::debugged || Traits<T2>::debugged) && Traits<Debug>::error)> d;
+    d << Debug::begl;
+    d << Debug::error;
+    return d;
 }
 
 // Warning
@@ -0,0 +1,117 @@
+#ifndef deque_h
+#define deque_h
+
+#include <atomic>
+#include "traits.h"
+
+__BEGIN_API
+
+// Work-Stealing Deque (Chase-Lev, com as barreiras de Lê et al., PPoPP'13)
+// Apenas o dono insere (push) e retira pelo fundo (pop); qualquer thread do kernel
+// pode retirar pelo topo (steal). O vetor circular cresce quando enche; os vetores
+// antigos só são liberados no destrutor, pois um steal concorrente ainda pode lê-los.
+template<typename T>
+class Work_Stealing_Deque
+{
+private:
+    struct Array
+    {
+        Array(long c, Array * p = 0): capacity(c), previous(p), buffer(new std::atomic<T>[c]) {}
+        ~Array() { delete [] buffer; }
+
+        T get(long i) const { return buffer[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        void put(long i, T x) { buffer[i & (capacity - 1)].store(x, std::memory_order_relaxed); }
+
+        long capacity;
+        Array * previous;
+        std::atomic<T> * buffer;
+    };
+
+public:
+    Work_Stealing_Deque(long capacity = 256): _top(0), _bottom(0), _array(new Array(capacity)) {}
+
+    ~Work_Stealing_Deque() {
+        Array * a = _array.load(std::memory_order_relaxed);
+        while (a) {
+            Array * p = a->previous;
+            delete a;
+            a = p;
+        }
+    }
+
+    bool empty() const { return size() <= 0; }
+
+    long size() const {
+        return _bottom.load(std::memory_order_relaxed) - _top.load(std::memory_order_relaxed);
+    }
+
+    // Só o dono.
+    void push(T x) {
+        long b = _bottom.load(std::memory_order_relaxed);
+        long t = _top.load(std::memory_order_acquire);
+        Array * a = _array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+            a = grow(a, t, b);
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Só o dono. Retira o último inserido (LIFO).
+    bool pop(T & x) {
+        long b = _bottom.load(std::memory_order_relaxed) - 1;
+        Array * a = _array.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = _top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        x = a->get(b);
+        if (t == b) {
+            bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        return true;
+    }
+
+    // Qualquer thread, inclusive o dono. Retira o mais antigo (FIFO).
+    bool steal(T & x) {
+        for (;;) {
+            long t = _top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long b = _bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return false;
+
+            Array * a = _array.load(std::memory_order_acquire);
+            x = a->get(t);
+            if (_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return true;
+            // Perdeu a disputa para outro steal ou para o pop do dono: tenta de novo.
+        }
+    }
+
+private:
+    Array * grow(Array * a, long t, long b) {
+        Array * bigger = new Array(a->capacity * 2, a);
+        for (long i = t; i < b; i++)
+            bigger->put(i, a->get(i));
+        _array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+private:
+    std::atomic<long> _top;
+    std::atomic<long> _bottom;
+    std::atomic<Array *> _array;
+};
+
+__END_API
+
+#endif
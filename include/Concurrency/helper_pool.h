@@ -0,0 +1,71 @@
+#ifndef helper_pool_h
+#define helper_pool_h
+
+#include <pthread.h>
+#include "Concurrency/traits.h"
+#include "Concurrency/thread.h"
+
+__BEGIN_API
+
+/*
+ * Pool de threads do kernel auxiliares, para chamadas que não têm versão não bloqueante.
+ * A Thread que chama execute() dorme enquanto um auxiliar executa job->run(); as demais continuam
+ * executando. Ao terminar, o auxiliar sinaliza o reator de E/S (ver IO::complete()), que acorda a Thread.
+ * Os Traits<Helper_Pool>::helpers auxiliares são criados no primeiro uso; se nenhum puder ser criado,
+ * execute() executa o job na própria Thread.
+ */
+class Helper_Pool
+{
+    friend class IO;
+
+public:
+    class Job
+    {
+        friend class Helper_Pool;
+        friend class IO;
+
+    public:
+        Job(): _thread(0), _next(0) {}
+        virtual ~Job() {}
+
+        virtual void run() = 0; // executado em um auxiliar: não pode usar Thread nem Semaphore.
+
+    private:
+        Thread * _thread;
+        Job * _next;
+    };
+
+    // Job que chama function(object) (ver Thread::offload()).
+    class Call: public Job
+    {
+    public:
+        Call(void (* function)(void *), void * object): _function(function), _object(object) {}
+
+        void run() { _function(_object); }
+
+    private:
+        void (* _function)(void *);
+        void * _object;
+    };
+
+    static void execute(Job * job);
+
+private:
+    static void start(); // cria os auxiliares (uma vez, por _once).
+    static void * helper(void *);
+    static Job * take() { return __atomic_exchange_n(&_done, (Job *)0, __ATOMIC_ACQUIRE); } // jobs concluídos.
+    static bool done() { return __atomic_load_n(&_done, __ATOMIC_RELAXED) != 0; }
+
+private:
+    static pthread_mutex_t _mutex;
+    static pthread_cond_t _cond;
+    static Job * _head; // fila de jobs a executar, protegida por _mutex.
+    static Job * _tail;
+    static Job * _done; // pilha de jobs concluídos (sem trava).
+    static pthread_once_t _once;
+    static unsigned int _helpers; // auxiliares criados; só muda dentro de start().
+};
+
+__END_API
+
+#endif
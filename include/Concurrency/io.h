@@ -0,0 +1,108 @@
+#ifndef io_h
+#define io_h
+
+#include <vector>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "Concurrency/traits.h"
+#include "Concurrency/thread.h"
+#include "Concurrency/ring.h"
+#include "Concurrency/helper_pool.h"
+
+__BEGIN_API
+
+/*
+ * Reator de E/S com epoll, integrado ao despachante.
+ * As funções abaixo têm a semântica das chamadas de sistema de mesmo nome, mas, quando a operação
+ * bloquearia, apenas a Thread que a chamou dorme (na fila do descritor) e as demais continuam executando.
+ * O descritor é colocado em modo não bloqueante e registrado no epoll (edge-triggered) no primeiro uso;
+ * por isso, descritores usados aqui devem ser fechados com IO::close().
+ * Quando não há threads prontas, o despachante bloqueia em epoll_wait até um descritor ficar pronto
+ * ou o próximo temporizador expirar.
+ *
+ * pread/pwrite (arquivos) vão para o io_uring: as submissões das threads que dormem em uma passada do
+ * despachante são enviadas juntas em um único io_uring_enter, e cada conclusão acorda a thread
+ * correspondente. Sem io_uring (kernel antigo ou Traits<IO>::uring = false), as chamadas são executadas
+ * no Helper_Pool.
+ */
+class IO
+{
+    friend class Thread;
+    friend class Helper_Pool;
+
+public:
+    typedef Thread::Microsecond Microsecond;
+
+    static ssize_t read(int fd, void * buf, size_t count);
+    static ssize_t write(int fd, const void * buf, size_t count);
+    static int accept(int fd, sockaddr * addr, socklen_t * addrlen);
+    static int connect(int fd, const sockaddr * addr, socklen_t addrlen);
+
+    // Espera até fd ficar pronto para events (POLLIN/POLLOUT) por até timeout microssegundos (negativo: sem prazo).
+    // Devolve os eventos prontos (como revents de poll(2)), 0 se o prazo expirou ou -1 em erro.
+    static int poll(int fd, short events, const Microsecond & timeout = -1);
+
+    static int close(int fd);
+
+    static ssize_t pread(int fd, void * buf, size_t count, off_t offset);
+    static ssize_t pwrite(int fd, const void * buf, size_t count, off_t offset);
+
+private:
+    enum Direction { IN, OUT, ANY, DIRECTIONS };
+    enum Source { INTERRUPT, COMPLETION }; // data.u64 dos eventfds no epoll.
+
+    struct Descriptor
+    {
+        Descriptor(int f): fd(f), registered(false) { for (int i = 0; i < DIRECTIONS; i++) sequence[i] = 0; }
+
+        int fd;
+        bool registered;
+        volatile unsigned int sequence[DIRECTIONS]; // eventos recebidos, para não dormir depois de um evento já consumido.
+        Thread::Asleep_Queue waiting[DIRECTIONS];
+    };
+
+    // Operação de arquivo do io_uring (ou, sem ele, executada no Helper_Pool).
+    struct Request: public Helper_Pool::Job
+    {
+        Request(unsigned char o, int f, void * b, size_t c, off_t off): opcode(o), fd(f), buf(b), count(c), offset(off), result(0) {}
+
+        void run();
+
+        unsigned char opcode;
+        int fd;
+        void * buf;
+        size_t count;
+        off_t offset;
+        ssize_t result; // como o res do io_uring: negativo é -errno.
+    };
+
+    static void init(); // cria o epoll (e o anel) no primeiro uso, com Thread::lock() adquirido.
+    static ssize_t submit(Request * request);
+    static Descriptor * descriptor(int fd);
+    // Dorme até um evento na direção d de desc (ou o prazo expirar), a menos que já tenha chegado algum depois de sequence.
+    static bool wait(Descriptor * desc, Direction d, unsigned int sequence, const Microsecond & deadline = 0);
+    static void wake(Descriptor * desc, Direction d);
+
+    // Usados pelo despachante (ver Thread::dispatcher() e Thread::check_events()).
+    static bool waiting() { return _waiting > 0; }
+    static void check(); // consulta o epoll sem bloquear, no máximo uma vez a cada Traits<IO>::interval.
+    static void react(const Microsecond & timeout); // epoll_wait por até timeout microssegundos (negativo: sem prazo), acordando as threads.
+    static void interrupt(); // tira de epoll_wait os workers bloqueados (término).
+    static void flush(); // envia ao io_uring as submissões acumuladas.
+    static void complete(); // acorda as threads cujas operações do anel ou do Helper_Pool terminaram (trava adquirida).
+    static bool completed() { return (_ring.ready() && _ring.completed()) || Helper_Pool::done(); }
+    static void signal(); // sinaliza _completion (usado pelos auxiliares do Helper_Pool).
+
+private:
+    static int _epoll;
+    static int _event; // eventfd usado por interrupt().
+    static int _completion; // eventfd sinalizado pelo anel e pelo Helper_Pool a cada conclusão.
+    static Ring _ring;
+    static volatile int _waiting; // threads dormindo em descritores ou em operações do anel e do Helper_Pool.
+    static volatile Microsecond _last_check;
+    static std::vector<Descriptor *> _descriptors; // indexado pelo fd. Protegido por Thread::lock().
+};
+
+__END_API
+
+#endif
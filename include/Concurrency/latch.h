@@ -0,0 +1,36 @@
+#ifndef latch_h
+#define latch_h
+
+#include "Concurrency/thread.h"
+#include "Concurrency/traits.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/list.h"
+
+__BEGIN_API
+
+/*
+ * Contador de uso único: wait() dorme até que count_down() leve o contador a zero (ou abaixo, com um
+ * aviso), quando todas as threads esperando são acordadas de uma vez. count_down() que não zera o contador é uma única operação
+ * atômica, sem a trava.
+ */
+class Latch
+{
+public:
+    typedef Ordered_List<Thread> Asleep_Queue;
+
+    Latch(int count): _count(count) {}
+    ~Latch();
+
+    void count_down(int n = 1);
+    bool try_wait() { return __atomic_load_n(&_count, __ATOMIC_ACQUIRE) <= 0; }
+    void wait();
+    void arrive_and_wait(int n = 1) { count_down(n); wait(); }
+
+private:
+    Asleep_Queue _asleep;
+    volatile int _count;
+};
+
+__END_API
+
+#endif
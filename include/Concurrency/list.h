@@ -34,7 +34,7 @@ namespace List_Elements
 
     public:
         Doubly_Linked_Ordered() { }
-        Doubly_Linked_Ordered(const T * o,  const R & r = 0): _object(o), _rank(r), _prev(0), _next(0) {}
+        Doubly_Linked_Ordered(const T * o,  const R & r = 0): _object(o), _rank(r), _prev(0), _next(0), _child(0), _sequence(0) {}
 
         T * object() const { return const_cast<T *>(_object); }
 
@@ -43,6 +43,13 @@ namespace List_Elements
         void prev(Element * e) { _prev = e; }
         void next(Element * e) { _next = e; }
 
+        // Só usado por Pairing_Heap: primeiro filho do nó.
+        Element * child() const { return _child; }
+        void child(Element * e) { _child = e; }
+        // Só usado por Pairing_Heap: ordem de inserção, para desempatar ranks iguais.
+        unsigned long sequence() const { return _sequence; }
+        void sequence(unsigned long s) { _sequence = s; }
+
         const R & rank() const { return _rank; }
         void rank(const R & r) { _rank = r; }
         int promote(const R & n = 1) { _rank -= n; return _rank; }
@@ -53,6 +60,8 @@ namespace List_Elements
         R _rank;
         Element * _prev;
         Element * _next;
+        Element * _child;
+        unsigned long _sequence;
     };
 
 }
@@ -461,6 +470,144 @@ public:
     }
 };
 
+// Pairing Heap (min-heap pelo rank) sobre o mesmo elemento das listas ordenadas
+// Alternativa à Ordered_List quando só se retira o menor elemento ou um elemento conhecido:
+// insert é O(1) e remove()/remove(e) são O(log n) amortizados, no lugar do insert O(n) da lista.
+// No elemento, next() é o próximo irmão, child() o primeiro filho e prev() o irmão anterior
+// (ou o pai, para o primeiro filho).
+template<typename T,
+          typename R = List_Element_Rank,
+          typename El = List_Elements::Doubly_Linked_Ordered<T, R> >
+class Pairing_Heap
+{
+public:
+    typedef T Object_Type;
+    typedef R Rank_Type;
+    typedef El Element;
+
+public:
+    Pairing_Heap(): _size(0), _sequence(0), _root(0) {}
+
+    bool empty() const { return (_size == 0); }
+    unsigned int size() const { return _size; }
+
+    Element * head() { return _root; }
+
+    void insert(Element * e) {
+        db<Lists>(TRC) << "Pairing_Heap::insert(e=" << e << ",o=" << (e ? e->object() : (void *) -1) << ")\n";
+
+        e->prev(0);
+        e->next(0);
+        e->child(0);
+        e->sequence(++_sequence);
+        _root = _root ? meld(_root, e) : e;
+        _size++;
+    }
+
+    Element * remove() { return remove_head(); }
+
+    Element * remove_head() {
+        db<Lists>(TRC) << "Pairing_Heap::remove_head()\n";
+
+        if(empty())
+            return 0;
+        Element * e = _root;
+        _root = merge_pairs(e->child());
+        _size--;
+        e->child(0);
+        return e;
+    }
+
+    Element * remove(Element * e) {
+        db<Lists>(TRC) << "Pairing_Heap::remove(e=" << e << ",o=" << (e ? e->object() : (void *) -1) << ")\n";
+
+        if(e == _root)
+            return remove_head();
+
+        // Desliga a subárvore de e e junta seus filhos de volta à raiz.
+        if(e->prev()->child() == e)
+            e->prev()->child(e->next());
+        else
+            e->prev()->next(e->next());
+        if(e->next())
+            e->next()->prev(e->prev());
+
+        Element * sub = merge_pairs(e->child());
+        if(sub)
+            _root = meld(_root, sub);
+        _size--;
+
+        e->prev(0);
+        e->next(0);
+        e->child(0);
+        return e;
+    }
+
+protected:
+    // b sai antes de a: menor rank ou, com ranks iguais (os ranks das threads são timestamps em
+    // microssegundos), inserido antes. Assim elementos com o mesmo rank saem na ordem de inserção, como
+    // na Ordered_List.
+    static bool precedes(const Element * b, const Element * a) {
+        return b->rank() < a->rank() || (!(a->rank() < b->rank()) && (long)(b->sequence() - a->sequence()) < 0);
+    }
+
+    // Junta duas raízes: a que sai depois (ver precedes()) vira o primeiro filho da outra.
+    static Element * meld(Element * a, Element * b) {
+        if(precedes(b, a)) {
+            Element * t = a;
+            a = b;
+            b = t;
+        }
+        b->prev(a);
+        b->next(a->child());
+        if(a->child())
+            a->child()->prev(b);
+        a->child(b);
+        return a;
+    }
+
+    // Junta os irmãos a partir de first em duas passadas (da esquerda para a direita aos pares, e depois
+    // da direita para a esquerda), o que garante o custo amortizado logarítmico.
+    static Element * merge_pairs(Element * first) {
+        if(!first)
+            return 0;
+
+        Element * pairs = 0; // árvores já pareadas, da última para a primeira, ligadas por next().
+        while(first) {
+            Element * a = first;
+            Element * b = a->next();
+            first = b ? b->next() : 0;
+
+            a->prev(0);
+            a->next(0);
+            if(b) {
+                b->prev(0);
+                b->next(0);
+                a = meld(a, b);
+            }
+            a->next(pairs);
+            pairs = a;
+        }
+
+        Element * root = pairs;
+        pairs = pairs->next();
+        root->next(0);
+        while(pairs) {
+            Element * n = pairs->next();
+            pairs->next(0);
+            root = meld(root, pairs);
+            pairs = n;
+        }
+        root->prev(0);
+        return root;
+    }
+
+private:
+    unsigned int _size;
+    unsigned long _sequence; // inserções feitas.
+    Element * _root;
+};
+
 __END_API
 
 #endif
@@ -0,0 +1,50 @@
+#ifndef mutex_h
+#define mutex_h
+
+#include "Concurrency/cpu.h"
+#include "Concurrency/thread.h"
+#include "Concurrency/traits.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/list.h"
+
+__BEGIN_API
+
+/*
+ * Exclusão mútua com dono. lock() e unlock() sem disputa são um único CAS/troca atômica; só quem precisa
+ * dormir, ou liberar com threads dormindo, adquire Thread::lock() (como o mutex sobre futex de Drepper:
+ * _state 0 livre, 1 ocupado, 2 ocupado com threads esperando).
+ * Uma thread acordada por unlock() volta a disputar o mutex com as que chegarem, sem troca de contexto
+ * (para entrega direta, ver Semaphore). Com recursive, o dono pode readquirir o mutex, que só é liberado
+ * no unlock() correspondente ao primeiro lock().
+ */
+class Mutex
+{
+    friend class Condition;
+
+public:
+    typedef Ordered_List<Thread> Asleep_Queue;
+
+    Mutex(bool recursive = false): _state(0), _owner(0), _depth(0), _recursive(recursive) {}
+    ~Mutex();
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    Thread * owner() { return _owner; }
+
+private:
+    void acquired(Thread * running) { _owner = running; _depth = 1; }
+    void release(); // libera o mutex com Thread::lock() adquirido (não libera a trava).
+
+private:
+    Asleep_Queue _asleep;
+    volatile int _state;
+    Thread * volatile _owner;
+    unsigned int _depth; // lock()s aninhados do dono (mutex recursivo).
+    bool _recursive;
+};
+
+__END_API
+
+#endif
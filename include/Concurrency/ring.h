@@ -0,0 +1,76 @@
+#ifndef ring_h
+#define ring_h
+
+#include <linux/io_uring.h>
+#include "traits.h"
+
+__BEGIN_API
+
+// Anel de submissão/conclusão do io_uring, sem a liburing: só as chamadas de sistema e os mapeamentos.
+// As entradas obtidas com sqe() só vão para o kernel em submit(), de forma que várias submissões
+// sejam enviadas em um único io_uring_enter. Não é sincronizado: quem usa deve garantir a exclusão mútua.
+class Ring
+{
+public:
+    Ring(): _fd(-1), _to_submit(0) {}
+    ~Ring();
+
+    bool init(unsigned int entries); // false se o io_uring não estiver disponível.
+    bool ready() const { return _fd >= 0; }
+
+    io_uring_sqe * sqe(); // próxima entrada livre da fila de submissão (zerada), ou 0 se a fila está cheia.
+    void push(); // confirma a entrada obtida com sqe().
+    // Entradas confirmadas que o kernel ainda não consumiu, inclusive as de um submit() que falhou.
+    unsigned int pending() const { return *_sq_tail + _to_submit - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE); }
+    // Envia as entradas pendentes; devolve quantas o kernel aceitou, ou -1 (errno) se não aceitou nenhuma.
+    // As recusadas continuam pendentes e vão na próxima chamada.
+    int submit();
+
+    int register_eventfd(int fd); // fd é sinalizado a cada conclusão.
+
+    bool completed() const {
+        return __atomic_load_n(_cq_head, __ATOMIC_RELAXED) != __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    // Consome as conclusões disponíveis, chamando f(user_data, res) para cada uma.
+    template<typename F>
+    unsigned int reap(F f) {
+        unsigned int head = *_cq_head;
+        unsigned int tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        unsigned int n = tail - head;
+        for (; head != tail; head++) {
+            io_uring_cqe * cqe = &_cqes[head & *_cq_mask];
+            f(cqe->user_data, cqe->res);
+        }
+        __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        return n;
+    }
+
+private:
+    static bool supports(int fd, unsigned int opcode); // IORING_REGISTER_PROBE
+
+    int _fd;
+    unsigned int _to_submit;
+
+    void * _sq_map;
+    void * _cq_map;
+    unsigned int _sq_map_size;
+    unsigned int _cq_map_size;
+    unsigned int _sqes_size;
+
+    unsigned int * _sq_head;
+    unsigned int * _sq_tail;
+    unsigned int * _sq_mask;
+    unsigned int * _sq_array;
+    unsigned int _sq_entries;
+    io_uring_sqe * _sqes;
+
+    unsigned int * _cq_head;
+    unsigned int * _cq_tail;
+    unsigned int * _cq_mask;
+    io_uring_cqe * _cqes;
+};
+
+__END_API
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef rwlock_h
+#define rwlock_h
+
+#include "Concurrency/thread.h"
+#include "Concurrency/traits.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/list.h"
+
+__BEGIN_API
+
+/*
+ * Trava de leitores e escritores para estado lido com frequência e escrito raramente.
+ * Leitores entram juntos enquanto não há escritor ativo nem esperando; um escritor esperando barra
+ * os leitores que chegam depois dele (sem inanição de escritores). Ao liberar, o escritor admite de
+ * uma vez todos os leitores que esperavam (um lote, acordado em uma única passada), e só então
+ * o próximo escritor (sem inanição de leitores). Quem acorda já recebe a trava: não disputa de novo.
+ */
+class RWLock
+{
+public:
+    typedef Ordered_List<Thread> Asleep_Queue;
+
+    // Contadores de espera, em microssegundos, para medir a disputa.
+    struct Statistics
+    {
+        unsigned long long reads; // read_lock()s.
+        unsigned long long writes; // write_lock()s.
+        unsigned long long read_waits; // read_lock()s que dormiram.
+        unsigned long long write_waits; // write_lock()s que dormiram.
+        Thread::Microsecond read_wait_time;
+        Thread::Microsecond write_wait_time;
+    };
+
+    RWLock(): _readers(0), _writer(false), _statistics() {}
+    ~RWLock();
+
+    void read_lock();
+    bool try_read_lock();
+    void read_unlock();
+
+    void write_lock();
+    bool try_write_lock();
+    void write_unlock();
+
+    const Statistics & statistics() const { return _statistics; }
+
+private:
+    void release(bool writer); // passa adiante a trava que ficou livre, com Thread::lock() adquirido (não libera a trava).
+    void account(unsigned long long & waits, Thread::Microsecond & time, const Thread::Microsecond & since);
+
+private:
+    Asleep_Queue _waiting_readers;
+    Asleep_Queue _waiting_writers;
+    unsigned int _readers; // leitores com a trava. Protegido por Thread::lock(), assim como _writer.
+    bool _writer;
+    Statistics _statistics;
+};
+
+__END_API
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef select_h
+#define select_h
+
+#include "Concurrency/thread.h"
+#include "Concurrency/semaphore.h"
+#include "Concurrency/channel.h"
+#include "Concurrency/traits.h"
+#include "Concurrency/debug.h"
+
+__BEGIN_API
+
+/*
+ * Espera pelo primeiro de vários eventos: recv() ou send() em canais e p() em semáforos, com prazo opcional.
+ * Os casos são registrados uma vez (cada registro devolve o índice do caso) e wait() pode ser chamado
+ * repetidamente: ele completa o primeiro caso pronto, na ordem de registro, ou dorme uma única vez em todas as
+ * filas ao mesmo tempo. Quem torna um caso pronto o completa (entrega o valor, o semáforo) e, com
+ * Thread::lock() ainda adquirido, tira a thread das demais filas antes de acordá-la; assim as filas nunca têm
+ * entradas de um Select que já terminou.
+ * Um caso de canal fechado também fica pronto, com ok() false.
+ *
+ *     Select select;
+ *     int work = select.recv(queue, job);
+ *     int stop = select.p(shutdown);
+ *     int i = select.wait(timeout); // work, stop ou NONE (prazo expirado)
+ */
+class Select
+{
+    friend class Thread;
+    friend class Semaphore;
+    friend class Channel_Common;
+
+public:
+    typedef Thread::Microsecond Microsecond;
+
+    static const int CASES = Traits<Select>::cases;
+    static const int NONE = -1; // wait() sem caso pronto até o prazo (ou registro além de CASES).
+
+    Select(): _count(0), _enrolled(0), _fired(NONE), _ok(false), _thread(0) {}
+
+    template<typename T, unsigned int N>
+    int recv(Channel<T, N> & channel, T & value) { return add(RECV, &channel, &Channel<T, N>::take, &value, 0); }
+    template<typename T, unsigned int N>
+    int send(Channel<T, N> & channel, T & value) { return add(SEND, &channel, &Channel<T, N>::give, &value, 0); }
+    int p(Semaphore & semaphore) { return add(P, 0, 0, 0, &semaphore); }
+
+    // Devolve o índice do caso completado ou NONE se o prazo (em microssegundos; negativo: sem prazo,
+    // 0: só verifica) expirar antes.
+    int wait(const Microsecond & timeout = -1);
+
+    bool ok() { return _ok; } // o caso completado transferiu o valor (false: canal fechado).
+
+private:
+    enum Kind { RECV, SEND, P };
+    typedef bool (* Attempt)(Channel_Common *, void *); // Channel::give() ou take(), com Thread::lock() adquirido.
+
+    struct Case
+    {
+        Case(): link(0) {}
+
+        Kind kind;
+        Channel_Common * channel;
+        Attempt attempt;
+        void * value;
+        Channel_Common::Waiter waiter; // nas filas do canal.
+        Semaphore * semaphore;
+        Thread::Asleep_Queue::Element link; // na fila do semáforo.
+    };
+
+    int add(Kind kind, Channel_Common * channel, Attempt attempt, void * value, Semaphore * semaphore);
+
+    // Com Thread::lock() adquirido:
+    bool attempt(Case & c); // completa o caso se estiver pronto.
+    bool enroll(Case & c); // coloca o caso na fila do canal ou semáforo; true se o semáforo foi obtido ao entrar.
+    void withdraw(int except); // tira os casos das filas, exceto o except (já retirado por quem o completou).
+    void fire(int i); // completa o caso i: tira os demais das filas e acorda a thread.
+    void fire(Channel_Common::Waiter * waiter) { _ok = !waiter->item; fire(index(waiter)); }
+    void fire(Thread::Asleep_Queue::Element * link) { _ok = true; fire(index(link)); }
+
+    int index(Channel_Common::Waiter * waiter);
+    int index(Thread::Asleep_Queue::Element * link);
+
+    // Select da entrada link de uma fila de semáforo, ou 0 se link é o de uma thread em p().
+    static Select * of(Thread::Asleep_Queue::Element * link) {
+        Thread * thread = link->object();
+        return link != &thread->_link ? thread->_select : 0;
+    }
+
+private:
+    Case _cases[CASES];
+    int _count;
+    int _enrolled; // casos nas filas (os primeiros), durante wait().
+    volatile int _fired;
+    volatile bool _ok;
+    Thread * _thread;
+};
+
+__END_API
+
+#endif
@@ -11,28 +11,51 @@ __BEGIN_API
 
 class Semaphore
 {
+    friend class Select;
+
 public:
     typedef Ordered_List<Thread> Asleep_Queue;
 
-    Semaphore(int v = 1) : _value(v) {}
+    // Com mais de um worker, p() espera ocupada um pouco antes de dormir (ver spin()).
+    static const bool SPIN = Thread::SMP && Traits<Semaphore>::spin;
+
+    Semaphore(int v = 1) : _value(v), _wakeups(0), _spins(0) {}
     ~Semaphore();
 
     void p();
-    void v();
+    // p() com prazo em microssegundos; devolve false se o prazo expirou sem obter o semáforo.
+    bool p(const Thread::Microsecond & timeout);
+    // p() só se o semáforo estiver livre; devolve false em vez de dormir.
+    bool try_p();
+    // Com uma thread esperando, v() lhe entrega o semáforo (ela não disputa com as que chegarem depois).
+    // Com reschedule, troca diretamente para ela; sem, ela só fica pronta e quem chamou v() continua.
+    void v(bool reschedule = Traits<Semaphore>::handoff);
 
 private:
     // Atomic operations
     int finc(volatile int & number);
     int fdec(volatile int & number);
 
-    // Thread operations
-    void sleep();
+    void spin(); // espera ocupada adaptativa enquanto o semáforo está ocupado.
+    bool cancel(); // desiste de um p() que já decrementou _value (com Thread::lock() adquirido).
+
+    // Thread operations (chamadas com Thread::lock() adquirido; retornam com a trava liberada)
+    bool sleep(const Thread::Microsecond & deadline = 0);
     void wakeup(bool reschedule = true);
     void wakeup_all();
+    void release(); // v() com Thread::lock() adquirido, sem ceder o processador (não libera a trava).
 
 private:
     Asleep_Queue _asleep;
+    // Negativo: -(número de threads em p() sem o semáforo). p() e v() sem disputa são um único fdec/finc,
+    // sem a trava; só quem precisa dormir ou acordar alguém a adquire.
     volatile int _value;
+    // Acordares de v() que não encontraram ninguém em _asleep: a thread que decrementou _value ainda não
+    // dormiu e, ao adquirir a trava, consome um deles em vez de dormir. Negativo: desistências (cancel()) que
+    // ficaram com o semáforo de um v() que ainda não adquiriu a trava; esse v() só o desconta. Protegido por
+    // Thread::lock().
+    int _wakeups;
+    volatile int _spins; // média das esperas ocupadas recentes, em iterações (estimativa do tempo de posse).
 };
 
 __END_API
@@ -0,0 +1,38 @@
+#ifndef spin_h
+#define spin_h
+
+#include "Concurrency/cpu.h"
+#include "Concurrency/traits.h"
+
+__BEGIN_API
+
+/*
+ * Spin lock usado para proteger as estruturas do escalonador quando há mais de uma thread do kernel
+ * executando threads (Traits<Thread>::workers > 1).
+ * Não é recursivo nem associado a um dono: pode ser liberado por uma thread diferente da que o adquiriu,
+ * o que permite passá-lo adiante em uma troca de contexto.
+ */
+class Spin
+{
+public:
+    Spin(): _locked(0) {}
+
+    void acquire() {
+        while (CPU::tsl(_locked))
+            while (_locked)
+                CPU::pause();
+    }
+
+    bool try_acquire() { return !CPU::tsl(_locked); }
+
+    void release() { CPU::clear(_locked); }
+
+    bool taken() const { return _locked; }
+
+private:
+    volatile int _locked;
+};
+
+__END_API
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef stack_pool_h
+#define stack_pool_h
+
+#include "Concurrency/traits.h"
+#include "Concurrency/debug.h"
+
+__BEGIN_API
+
+/*
+ * Pool de pilhas para CPU::Context.
+ * Cada pilha é mapeada com mmap e tem uma página de guarda PROT_NONE abaixo dela, de forma que
+ * um estouro de pilha gera uma falha de segmentação em vez de corromper memória vizinha.
+ * Pilhas devolvidas ficam em uma lista de livres (uma por tamanho) e são reaproveitadas pelas
+ * próximas threads, então criar uma thread não passa pelo malloc.
+ */
+class Stack_Pool
+{
+public:
+    static const bool LAZY = Traits<Stack_Pool>::lazy;
+    static const unsigned int STACK_SIZE = LAZY ? Traits<Stack_Pool>::reserve : Traits<CPU>::STACK_SIZE;
+    static const bool PAINT = Traits<Stack_Pool>::paint;
+    static const unsigned long CANARY = 0x5a5aa5a55a5aa5a5UL;
+
+    /*
+     * Retorna o endereço mais baixo da região utilizável de uma pilha de size bytes
+     * (arredondado para páginas inteiras).
+     * Lança std::bad_alloc caso não seja possível mapear uma nova pilha.
+     */
+    static char * alloc(unsigned int size = STACK_SIZE);
+
+    /*
+     * Devolve a pilha ao pool. Acima de Traits<Stack_Pool>::max_cached pilhas livres do mesmo tamanho,
+     * ou quando todos os tamanhos do pool já estão em uso, a memória é desmapeada.
+     */
+    static void free(char * stack, unsigned int size = STACK_SIZE);
+
+    /*
+     * Devolve ao SO as páginas da pilha abaixo de sp, que não estão em uso pelo contexto salvo.
+     */
+    static void trim(char * stack, void * sp);
+
+    /*
+     * Preenche a pilha com CANARY, para que usage() possa medir o pico de uso.
+     */
+    static void paint(char * stack, unsigned int size);
+
+    /*
+     * Retorna o maior número de bytes já usados de uma pilha pintada com paint().
+     */
+    static unsigned int usage(char * stack, unsigned int size);
+
+    /*
+     * Mapeia pilhas antecipadamente até que existam n pilhas livres de tamanho STACK_SIZE.
+     */
+    static void prewarm(unsigned int n);
+
+    static unsigned int cached(unsigned int size = STACK_SIZE); // número de pilhas livres de um tamanho.
+
+    static unsigned long round(unsigned int size); // tamanho efetivo (em páginas inteiras) de uma pilha.
+
+private:
+    // Lista de pilhas livres de um mesmo tamanho. O ponteiro para a próxima fica no início de cada pilha.
+    struct Bucket
+    {
+        unsigned long size;
+        char * free;
+        unsigned int cached;
+    };
+
+    static const unsigned int BUCKETS = 8;
+
+    static void lock();
+    static void unlock();
+    static Bucket * bucket(unsigned long size);
+    static char * map(unsigned long size);
+    static void unmap(char * stack, unsigned long size);
+    static void discard(char * begin, char * end);
+    static unsigned long page_size();
+
+private:
+    static Bucket _buckets[BUCKETS];
+    static Spin _lock; // só é usada com mais de um worker (Traits<Thread>::workers > 1).
+};
+
+__END_API
+
+#endif
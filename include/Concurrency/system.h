@@ -14,6 +14,7 @@ public:
      * Por enquanto deve apenas desativar o buffer de saída padrão usado pelo cout.
      * setvbuf (stdout, 0, _IONBF, 0) ;
      * Isso evita condições de corrida que podem ocorrer no buffer quando threads são usadas.
+     * (As mensagens de db<>() não passam por stdout: ver Debug.)
      * Deve ser chamado no início da função main.
      */ 
     static void init(void (*main)(void *));
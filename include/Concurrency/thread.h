@@ -6,8 +6,18 @@
 #include "Concurrency/debug.h"
 #include <queue>
 #include "Concurrency/list.h"
+#include "Concurrency/deque.h"
+#include "Concurrency/timing_wheel.h"
+#include "Concurrency/spin.h"
+#include "Concurrency/trace.h"
 #include <ctime>
 #include <chrono>
+#include <type_traits>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <stdio.h>
+#include <vector>
 
 using namespace std;
 
@@ -22,9 +32,57 @@ __BEGIN_API
 
         // Declaracao de Semaphore como friend class para permitir acessar ao ponteiro _running.
         friend class Semaphore;
-
-        typedef Ordered_List<Thread> Ready_Queue;
+        friend class Mutex;
+        friend class Condition;
+        friend class RWLock;
+        friend class Latch;
+        friend class Wait_Group;
+        friend class Barrier;
+        friend class Channel_Common;
+        friend class Select;
+        friend class IO;
+
+        // Fila de prontos (com um único worker): Pairing_Heap ou Ordered_List, conforme Traits<Thread>::ready_heap.
+        // As demais filas de threads continuam listas ordenadas, que compartilham o mesmo elemento (_link).
+        typedef std::conditional<Traits<Thread>::ready_heap, Pairing_Heap<Thread>, Ordered_List<Thread> >::type Ready_Queue;
+        typedef Ordered_List<Thread> Thread_Queue;
         typedef Ordered_List<Thread> Asleep_Queue;
+        typedef Work_Stealing_Deque<Thread *> Ready_Deque;
+        typedef Timing_Wheel<Thread, Traits<Thread>::tick> Timer_Wheel;
+        typedef Timer_Wheel::Microsecond Microsecond;
+
+        static const unsigned int WORKERS = Traits<Thread>::workers;
+        static const bool SMP = (WORKERS > 1);
+        static const bool DIRECT_SWITCH = Traits<Thread>::direct_switch;
+        static const bool PREEMPTIVE = Traits<Thread>::preemptive;
+        static const bool STATS = Traits<Thread>::stats;
+        static const bool STATS_TIME = STATS && Traits<Thread>::stats_time;
+
+        // Estado de cada thread do kernel que executa Threads (modelo M:N).
+        // Cada worker tem seu próprio despachante e, com mais de um worker, sua própria fila de prontos
+        // (ready), da qual os demais roubam threads quando ficam sem trabalho.
+        struct Worker {
+            Thread * running; // thread em execução neste worker.
+            Thread * dispatcher; // despachante deste worker.
+            Thread * prev; // thread que devolveu o processador ao despachante, cuja troca ainda não foi concluída.
+            bool requeue; // prev deve voltar para a fila de prontos.
+            bool locked; // prev passou a trava adquirida para o despachante.
+            Ready_Deque ready;
+            unsigned int seed; // escolha das vítimas de roubo.
+            CPU::Context native; // contexto da thread do kernel, para onde o despachante volta ao final.
+            pthread_t kernel;
+            unsigned int id;
+            volatile int disabled; // profundidade das seções com interrupções (preempção) desabilitadas.
+            volatile bool pending; // preempção adiada até o fim da seção.
+            timer_t timer; // temporizador do quantum (Traits<Thread>::preemptive).
+            bool preempted; // a troca em andamento é por fim do quantum (involuntária).
+            unsigned int idle; // passadas seguidas do despachante sem threads prontas (ver idle()).
+            // Contadores do worker (Traits<Thread>::stats), escritos só por ele.
+            unsigned long long switches; // trocas de contexto, inclusive de e para o despachante.
+            unsigned long long dispatched; // trocas feitas pelo despachante (as demais são diretas).
+            unsigned long long preemptions; // fins de quantum.
+            unsigned long long steals; // threads retiradas da fila de outro worker.
+        };
 
         // Thread State
         enum State {
@@ -34,6 +92,41 @@ __BEGIN_API
             FINISHING,
             WAITING
         };
+        static const unsigned int STATES = WAITING + 1;
+
+        // Estatísticas de execução de uma thread (Traits<Thread>::stats), desde a sua criação.
+        struct Statistics
+        {
+            int id;
+            State state;
+            unsigned long long time[STATES]; // nanossegundos em cada estado (time[RUNNING]: tempo de execução; só com stats_time).
+            unsigned long long dispatches; // vezes que recebeu o processador.
+            unsigned long long voluntary; // vezes que o devolveu (yield, espera, suspensão, término).
+            unsigned long long involuntary; // vezes que o perdeu por fim do quantum.
+        };
+
+        // Retrato do escalonador: contadores globais, somados sobre os workers, e as threads existentes.
+        struct Snapshot
+        {
+            unsigned long long uptime; // nanossegundos desde Thread::init().
+            unsigned long long switches; // trocas de contexto, inclusive de e para os despachantes.
+            unsigned long long dispatched; // trocas feitas pelos despachantes (as demais são trocas diretas).
+            unsigned long long preemptions;
+            unsigned long long steals; // threads retiradas da fila de outro worker.
+            unsigned long long dispatcher_time; // nanossegundos nos despachantes (escolha e espera sem threads prontas; stats_time).
+            std::vector<Statistics> threads; // exceto os despachantes.
+        };
+
+        // Atributos de criação de uma Thread.
+        struct Configuration {
+            // Menor pilha aceita: além do quadro inicial e dos argumentos, a thread executa o despacho e, com
+            // preempção, o tratador do SIGALRM. Tamanhos menores são aumentados para este (com um aviso).
+            static const unsigned int MIN_STACK_SIZE = 16 * 1024;
+
+            Configuration(unsigned int s = Stack_Pool::STACK_SIZE) : stack_size(s) {}
+
+            unsigned int stack_size; // tamanho da pilha, em bytes (arredondado para páginas inteiras).
+        };
 
         /*
          * Construtor vazio. Necessário para inicialização, mas sem importância para a execução das Threads.
@@ -49,10 +142,40 @@ __BEGIN_API
         template<typename ... Tn>
         Thread(void (* entry)(Tn ...), Tn ... an);
 
+        /*
+         * Igual ao construtor acima, mas com os atributos dados em conf (ex.: tamanho da pilha).
+         */
+        template<typename ... Tn>
+        Thread(const Configuration & conf, void (* entry)(Tn ...), Tn ... an);
+
         /*
          * Retorna a Thread que está em execução.
          */
-        static Thread * running() { return _running; }
+        static Thread * running() { return SMP ? current_running() : _workers[0].running; }
+
+        /*
+         * Retorna o worker (thread do kernel) que está executando a thread atual.
+         */
+        static Worker * worker() { return SMP ? current_worker() : &_workers[0]; }
+
+        /*
+         * Trava das estruturas do escalonador (fila de prontos, filas de espera, estados das threads).
+         * Só tem efeito com mais de um worker. Uma thread que troca de contexto com a trava adquirida
+         * a passa para o despachante, que a libera depois que o contexto da thread foi salvo.
+         */
+        static void lock() { if (SMP) _lock.acquire(); }
+        static void unlock() { if (SMP) _lock.release(); }
+        static bool try_lock() { return !SMP || _lock.try_acquire(); }
+
+        /*
+         * Seções com interrupções desabilitadas: com Traits<Thread>::preemptive, o fim do quantum dentro
+         * de uma seção só causa a troca de contexto quando a seção mais externa termina.
+         * Todas as operações do escalonador e do semáforo (e as listas que elas manipulam) executam
+         * dentro de uma seção. Código da aplicação que não pode ser interrompido por outra Thread no
+         * mesmo worker (ex.: chamadas não reentrantes da libc, como malloc e printf) também deve usá-las.
+         */
+        static void int_disable() { if (PREEMPTIVE) disable(); }
+        static void int_enable() { if (PREEMPTIVE) enable(); }
 
         /*
          * Método para trocar o contexto entre duas thread, a anterior (prev)
@@ -74,6 +197,24 @@ __BEGIN_API
          */
         int id();
 
+        /*
+         * Tamanho da pilha da thread e o maior número de bytes já usados dela.
+         * O pico de uso só é medido com Traits<Stack_Pool>::paint; caso contrário é 0.
+         */
+        unsigned int stack_size();
+        unsigned int stack_usage();
+
+        /*
+         * Estatísticas desta thread, incluindo o tempo no estado atual até agora (sem Traits<Thread>::stats, zeradas).
+         * stats() retrata todas as threads e os contadores dos despachantes; top() o escreve em out, como o top,
+         * com as `lines` threads que mais executaram (ou mais foram despachadas, sem stats_time) e as taxas desde
+         * a chamada anterior. O Snapshot aloca memória: com preempção, quem chama stats() deve destruí-lo
+         * dentro de int_disable(), como o top() faz.
+         */
+        Statistics statistics();
+        static Snapshot stats();
+        static void top(FILE * out = stdout, unsigned int lines = 20);
+
         /*
          * NOVO MÉTODO DESTE TRABALHO.
          * Daspachante (disptacher) de threads.
@@ -85,7 +226,7 @@ __BEGIN_API
         /*
          * NOVO MÉTODO DESTE TRABALHO.
          * Realiza a inicialização da class Thread.
-         * Cria as Threads main e dispatcher.
+         * Cria as Threads main e dispatcher (um por worker) e inicia os demais workers.
          */
         static void init(void (*main)(void *));
 
@@ -100,6 +241,23 @@ __BEGIN_API
          */
         ~Thread();
 
+        /*
+         * Alocação de Threads com interrupções desabilitadas: o malloc da libc não pode ser interrompido
+         * por outra Thread no mesmo worker (ver int_disable()).
+         */
+        static void * operator new(size_t size) {
+            int_disable();
+            void * p = ::operator new(size);
+            int_enable();
+            return p;
+        }
+
+        static void operator delete(void * p) {
+            int_disable();
+            ::operator delete(p);
+            int_enable();
+        }
+
         /*
          * Qualquer outro método que você achar necessário para a solução.
          */
@@ -111,8 +269,6 @@ __BEGIN_API
 
         static Thread* get_thread_to_dispatch_ready(); // retorna a próxima thread a ser executada.
 
-        static void prepare_dispatcher_to_run_again(); // prepara o dispatcher para ser executado novamente.
-
         static void check_if_next_thread_is_finished(); // verifica se a próxima thread a ser executada já terminou.
 
         static void return_to_main(); // retorna para a thread main.
@@ -121,54 +277,265 @@ __BEGIN_API
 
         static void create_main_thread(void (*main)(void *)); // Cria a thread main.
 
-        static void create_dispatcher_thread(); // Cria a thread dispatcher.
+        static void create_dispatcher_thread(); // Cria as threads dispatcher, uma por worker.
+
+        static void start_workers(); // Inicia as threads do kernel dos workers 1 a WORKERS-1.
 
         static int get_now_timestamp(); // retorna o tempo atual.
 
+        static void release_finished_threads(); // devolve ao pool as pilhas das threads que já terminaram.
+
+        static void trim_idle_stacks(); // devolve ao SO as páginas de pilha de threads dormindo/suspensas há muito tempo.
+
         int join(); // aguarda a thread terminar sua execução.
 
+        int join(const Microsecond & timeout); // join() que desiste após timeout microssegundos, devolvendo -1.
+
+        /*
+         * Bloqueia a thread em execução por um intervalo (sleep_for) ou até um instante (sleep_until, no
+         * relógio de now()). Com todas as threads dormindo, os workers bloqueiam no kernel até o próximo
+         * temporizador, em vez de esperar ocupados.
+         */
+        static void sleep_for(const Microsecond & duration);
+        static void sleep_until(const Microsecond & deadline);
+
+        static Microsecond now() { return Timer_Wheel::now(); } // relógio monotônico, em microssegundos.
+
+        /*
+         * Executa fn() em uma thread do kernel auxiliar (ver Helper_Pool) e devolve o seu resultado.
+         * Para chamadas que bloqueiam e não têm versão não bloqueante (fsync, open em sistemas de arquivos
+         * lentos, getaddrinfo, compressão...): só a Thread que chamou dorme, as demais continuam executando.
+         * fn não pode usar Thread nem Semaphore; o tipo de retorno, se houver, deve ter construtor padrão.
+         */
+        template<typename F>
+        static auto offload(F fn) -> decltype(fn()) {
+            Offloaded<decltype(fn()), F> call(fn);
+            offload(&Offloaded<decltype(fn()), F>::run, &call);
+            return call.result();
+        }
+
         void suspend(); // suspende a thread.
 
         void resume(); // retoma a execução da thread.
 
-        void sleep( Asleep_Queue* sleepQueue); // Coloca a thread em waiting.
+        // sleep e wakeup são usados pelas primitivas de sincronização: devem ser chamados com lock()
+        // adquirido e retornam com a trava liberada.
+        // Com deadline (instante em now(); 0 para nenhum), sleep desiste ao expirar o prazo: a thread sai da fila
+        // e sleep devolve false.
+        bool sleep(Asleep_Queue* sleepQueue, const Microsecond & deadline = 0); // Coloca a thread em waiting.
 
-        void wakeup(bool reschedule = true); // Acorda a thread.
+        // Acorda a thread. Com reschedule, a thread em execução cede o processador diretamente para ela
+        // (passagem de bastão), voltando para a fila de prontos; sem, só a torna pronta e continua.
+        void wakeup(bool reschedule = true);
+
+    private:
+        static Worker * current_worker(); // worker da thread do kernel atual (TLS).
+
+        static Thread * current_running(); // running() com mais de um worker.
+
+        static void disable(); // int_disable() com preempção.
+
+        static void enable(); // int_enable() com preempção.
+
+        static void * run_worker(void * worker); // corpo das threads do kernel dos workers 1 a WORKERS-1.
+
+        // Espera de um despachante sem threads prontas: ocupada por Traits<Thread>::idle_spins passadas e,
+        // depois, dormindo no kernel (park()) até que unpark() o acorde ou por no máximo um tick.
+        static void idle(Worker * w);
+        static bool park(); // true se acordado por unpark().
+        static void unpark(bool all = false); // acorda um (ou todos os) despachante(s) dormindo em park().
+        // Chamado depois de inserir uma thread em uma fila de worker: outro worker dormindo pode executá-la.
+        static void ready_pushed() {
+            __atomic_thread_fence(__ATOMIC_SEQ_CST); // pareado com o de park(): ou ele vê a thread, ou aqui se vê _parked.
+            if (__atomic_load_n(&_parked, __ATOMIC_RELAXED))
+                unpark();
+        }
+
+        // Devolve o processador para a próxima thread pronta ou, se não houver, para o despachante do
+        // worker atual. Com locked, deve ser chamado com lock() adquirido, que quem recebe o processador
+        // libera. Com requeue, a thread volta para a fila de prontos depois que seu contexto for salvo.
+        // Retorna, sem a trava, quando a thread for despachada novamente.
+        // Com to, troca para essa thread (já tirada da fila de prontos e em RUNNING) em vez da próxima pronta.
+        static void dispatch(bool locked = true, bool requeue = false, Thread * to = 0);
+
+        static void complete_switch(Worker * w); // conclui, em quem recebeu o processador, a troca iniciada por dispatch.
+
+        // Ponto de entrada de toda Thread: conclui a troca que a despachou pela primeira vez.
+        template<typename ... Tn>
+        static void launch(void (* entry)(Tn ...), Tn ... an) {
+            Worker * w = worker();
+            complete_switch(w);
+            w->disabled = 0; // a thread começa com as interrupções habilitadas.
+            entry(an...);
+        }
+
+        // Chamada de offload(), executada no auxiliar por run(object).
+        template<typename R, typename F>
+        struct Offloaded {
+            Offloaded(F & f): _fn(f), _result() {}
+            static void run(void * object) { Offloaded * o = reinterpret_cast<Offloaded *>(object); o->_result = o->_fn(); }
+            R result() { return _result; }
+            F & _fn;
+            R _result;
+        };
+        template<typename F>
+        struct Offloaded<void, F> {
+            Offloaded(F & f): _fn(f) {}
+            static void run(void * object) { reinterpret_cast<Offloaded *>(object)->_fn(); }
+            void result() {}
+            F & _fn;
+        };
+
+        static void offload(void (* run)(void *), void * object);
+
+        static Thread * steal(Worker * w); // procura uma thread pronta nas filas de todos os workers (SMP).
+
+        static bool take(Thread * t); // tenta despachar uma thread retirada de uma fila de worker (SMP).
+
+        static void reschedule(); // yield() com lock() já adquirido.
+
+        void wake(); // torna pronta uma thread em WAITING, com lock() já adquirido (não libera a trava).
+
+        void handoff(); // troca para esta thread, recém-acordada, com lock() já adquirido (ver wakeup()).
+
+        void timeout(); // prazo de sleep() expirado.
+
+        static void expire_timers(); // acorda as threads cujo prazo expirou, com lock() já adquirido.
+
+        static void check_events(bool locked); // expire_timers() se houver temporizadores armados; consulta o reator de E/S.
+
+        int join_until(const Microsecond & deadline); // join() com prazo (0 para nenhum).
+
+        static void preempt(); // fim do quantum: yield() da thread em execução.
+
+        static void start_timer(Worker * w); // arma o temporizador do quantum do worker atual.
+
+        static void timer_handler(int signal, siginfo_t * info, void * context); // tratador do SIGALRM do temporizador.
+
+        bool claim(State from, State to) { return __sync_bool_compare_and_swap(&_state, from, to); }
+
+        // Encerra o período no estado contado (_phase) em now (Trace::tsc()) e começa outro em phase.
+        void account(State phase, unsigned long long now) {
+            if (!STATS_TIME)
+                return;
+            _statistics.time[_phase] += now - _since;
+            _since = now;
+            _phase = phase;
+        }
+        // Contabiliza a troca de prev para next no worker w (contadores das duas e do worker).
+        static void switched(Worker * w, Thread * prev, Thread * next);
+        Statistics statistics(unsigned long long now, double per_ns); // statistics() em now, com per_ns ciclos por ns.
+
+        // Pontos de rastreamento (ver Trace), da thread em execução ou de thread. Sem Traits<Trace>::enabled,
+        // não geram código. O anel de cada worker tem um único escritor: a preempção fica desabilitada durante
+        // o registro, para que outra thread do mesmo worker (ou esta, migrada) não escreva na mesma posição.
+        static void trace(Trace::Event event, long arg = 0) {
+            if (Trace::ENABLED) { int_disable(); Trace::record(worker()->id, event, running()->_id, arg); int_enable(); }
+        }
+        static void trace(Trace::Event event, Thread * thread, long arg) {
+            if (Trace::ENABLED) { int_disable(); Trace::record(worker()->id, event, thread->_id, arg); int_enable(); }
+        }
+
+        bool remove_from_ready(State to); // retira uma thread pronta (que não está executando) da fila de prontos.
+
+        void drop_entries(); // descarta as referências obsoletas a esta thread nas filas dos workers (SMP).
+
+        bool runnable() { return _state == READY || _state == RUNNING; } // contada em _runnable.
+
+        bool is_dispatcher(); // verifica se a thread é o despachante de algum worker.
+
+        void resume_locked(); // resume() com lock() já adquirido.
+
+
+        void mark_idle(); // registra o início de um período dormindo/suspensa (pilhas preguiçosas).
+
+        void unmark_idle(); // encerra o período dormindo/suspensa.
 
     private:
         int _id;
         Context * volatile _context;
-        static Thread * _running;
         static Thread _main; // thread principal. Não
-        static CPU::Context _main_context;
-        static Thread _dispatcher;
+        static Thread _dispatchers[WORKERS];
+        static Worker _workers[WORKERS];
+        static thread_local Worker * _worker;
+        static Spin _lock;
+        static int _runnable; // threads (exceto despachantes) prontas ou executando. Protegido por lock().
+        static volatile bool _stopping; // todas as threads terminaram ou estão bloqueadas: os workers devem parar.
+        static volatile int _parked; // despachantes dormindo em park().
+        static volatile int _unparks; // palavra do futex de park(): muda a cada unpark().
         static Ready_Queue _ready;
-        static Ready_Queue _suspended;
+        static Thread_Queue _suspended;
+        static Thread_Queue _finished; // threads terminadas cuja pilha ainda não foi liberada.
+        static Thread_Queue _idle; // threads dormindo/suspensas, em ordem de início, cujas pilhas ainda não foram aparadas.
+        static Timer_Wheel _timers; // prazos de sleep(), sleep_for() e sleep_until(). Protegido por lock().
         Asleep_Queue* _asleep = nullptr;
-        Ready_Queue::Element _link;
+        Select * _select = nullptr; // Select em que a thread dorme (nas filas de todos os seus casos).
+        Thread_Queue::Element _link;
+        Thread_Queue::Element _idle_link;
+        int _idle_since = 0; // diferente de 0 enquanto a thread está em _idle.
+        static Thread_Queue _threads; // todas as threads existentes, para stats() (Traits<Thread>::stats).
+        Thread_Queue::Element _thread_link;
+        Statistics _statistics = {}; // time em ciclos de Trace::tsc(), convertidos em statistics().
+        unsigned long long _since = 0; // início do período em _phase.
+        State _phase = READY; // estado em que o tempo está sendo contado (segue _state nas trocas).
         volatile State _state; // Como o estado da thread pode ser alterado por outra thread, é necessário que ele seja volátil.
         // Volatile garante que o compilador não otimize o código para esse estado.
 
         /*
          * Qualquer outro atributo que você achar necessário para a solução.
          */
-        static int _available_id; // id disponível para a próxima thread a ser criada. Unsigned int porque é sempre positivo.
+        static int _available_id; // maior id já atribuído; ids de threads terminadas são reaproveitados antes (_released_ids).
         static int _numOfThreads; // número de threads criadas.
         static queue<int> _released_ids; // fila de ids que foram liberados, mas ainda não foram reutilizados.
-        Thread* _waiting = nullptr; // thread que espera a execução desta thread terminar.
+        Asleep_Queue _joining; // threads que esperam a execução desta thread terminar.
+        Timer_Wheel::Element _alarm; // prazo da thread em WAITING, se houver.
+        bool _timed_out = false;
+        volatile int _entries = 0; // referências a esta thread nas filas dos workers, inclusive as obsoletas (SMP).
         int _exit_code; // código de término da thread.
     };
 
     template <typename ... Tn>
-    inline Thread::Thread(void (*entry)(Tn...), Tn... an) : _link(this, Thread::get_now_timestamp())
+    inline Thread::Thread(void (*entry)(Tn...), Tn... an) : Thread(Configuration(), entry, an...) {}
+
+    template <typename ... Tn>
+    inline Thread::Thread(const Configuration & conf, void (*entry)(Tn...), Tn... an) : _link(this, Thread::get_now_timestamp()), _idle_link(this), _thread_link(this), _alarm(this)
     {
+        // Uma pilha de 0 bytes, ou menor que o quadro inicial, faria o Context escrever na página de guarda.
+        unsigned int stack_size = conf.stack_size;
+        if (stack_size < Configuration::MIN_STACK_SIZE)
+        {
+            db<Thread>(WRN) << "Thread: stack_size=" << stack_size << " muito pequeno, usando " << Configuration::MIN_STACK_SIZE << ".\n";
+            stack_size = Configuration::MIN_STACK_SIZE;
+        }
+
+        int_disable();
+
+        this->_context = new Context(stack_size, &launch<Tn...>, entry, an...);
+
+        lock();
+
         this->_id = get_available_id();
+        this->_state = READY;
+        trace(Trace::CREATE, this, 0);
+        if (STATS)
+        {
+            _since = Trace::tsc();
+            _threads.insert_tail(&_thread_link);
+        }
+
+        // A main e os despachantes não entram na fila de prontos.
+        bool user = (this != &_main && !is_dispatcher());
 
         Thread::_numOfThreads++;
+        if (user)
+            _runnable++;
+
+        unlock();
 
-        this->_context = new Context(entry, an...);
+        if (user)
+            insert_thread_link_on_ready_queue(this);
 
-        insert_thread_link_on_ready_queue(this);
+        int_enable();
 
         db<Thread>(TRC) << "THREAD " << this->_id << " CRIADA.\n";
         db<Thread>(TRC) << Thread::_numOfThreads << " THREADS EXISTENTES.\n";
@@ -181,21 +548,26 @@ __BEGIN_API
     {
         {
             db<Thread>(TRC) << "ESCOLHENDO THREAD A SER DESPACHADA.\n";
-            Thread* next = _ready.remove_head()->object();
-            next->_state = RUNNING;
-            _running = next;
+            Thread* next;
+            if (SMP)
+            {
+                next = steal(worker());
+                if (!next)
+                    return 0;
+            }
+            else
+            {
+                if (_ready.empty())
+                    return 0;
+                next = _ready.remove_head()->object();
+                next->_state = RUNNING;
+            }
+            worker()->running = next;
 
             return next;
         }
     }
 
-    inline void Thread::prepare_dispatcher_to_run_again()
-    {
-        db<Thread>(TRC) << "PREPARANDO DESPACHANTE PARA EXECUTAR NOVAMENTE.\n";
-        _dispatcher._state = READY;
-        _ready.insert(&Thread::_dispatcher._link);
-    }
-
     inline int Thread::switch_context(Thread * prev, Thread * next)
     {
         if (prev == next) // Se a thread que está executando é a mesma que será executada, não há necessidade de trocar o contexto.
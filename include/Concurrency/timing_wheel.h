@@ -0,0 +1,200 @@
+#ifndef timing_wheel_h
+#define timing_wheel_h
+
+#include <time.h>
+#include "traits.h"
+#include "debug.h"
+
+__BEGIN_API
+
+// Timing Wheel hierárquico (como o dos timers do Linux)
+// O tempo é contado em ticks de tick microssegundos. O primeiro nível tem um slot
+// por tick; cada nível seguinte cobre o anterior inteiro em cada slot. Os elementos dos níveis superiores
+// descem de nível (cascata) quando o primeiro nível dá a volta. Inserir e remover são O(1); avançar o
+// relógio custa O(1) por tick mais os elementos expirados e os que descem de nível.
+// Não é sincronizado: quem usa deve garantir a exclusão mútua.
+template<typename T, unsigned int tick = 1000>
+class Timing_Wheel
+{
+public:
+    typedef long long Microsecond;
+    typedef unsigned long long Tick;
+
+    static const unsigned int TICK = tick;
+
+    class Element
+    {
+        friend class Timing_Wheel;
+
+    public:
+        Element(const T * o = 0): _object(o), _prev(0), _next(0), _expires(0) {}
+
+        T * object() const { return const_cast<T *>(_object); }
+        Element * next() const { return _next; }
+
+        bool armed() const { return _prev != 0; }
+        Tick expires() const { return _expires; }
+
+    private:
+        const T * _object;
+        Element * _prev;
+        Element * _next;
+        Tick _expires;
+    };
+
+private:
+    static const unsigned int ROOT_BITS = 8;
+    static const unsigned int LEVEL_BITS = 6;
+    static const unsigned int LEVELS = 5; // 8 + 4 * 6 = 32 bits de ticks (~49 dias com ticks de 1 ms).
+    static const unsigned int ROOT_SIZE = 1 << ROOT_BITS;
+    static const unsigned int LEVEL_SIZE = 1 << LEVEL_BITS;
+
+    // Lista circular com sentinela, de forma que um elemento saia do slot sem saber qual é.
+    struct Slot: public Element {
+        Slot() { this->_prev = this; this->_next = this; }
+        bool empty() const { return this->_next == this; }
+    };
+
+public:
+    Timing_Wheel(): _clock(ticks(now())), _size(0) {}
+
+    // Relógio monotônico em microssegundos.
+    static Microsecond now() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (Microsecond)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    // Tick em que um instante já passou, arredondando para cima: um elemento nunca expira antes da hora.
+    static Tick ticks(const Microsecond & t) { return (t + TICK - 1) / TICK; }
+    static Microsecond time(const Tick & t) { return (Microsecond)t * TICK; }
+
+    bool empty() const { return (_size == 0); }
+    unsigned int size() const { return _size; }
+
+    // Arma o elemento e para expirar em deadline (microssegundos, no relógio de now()).
+    void insert(Element * e, const Microsecond & deadline) {
+        db<Lists>(TRC) << "Timing_Wheel::insert(e=" << e << ",d=" << deadline << ")\n";
+
+        // Vazia, a roda não é avançada por expire(): acerta o relógio antes de posicionar.
+        if(empty() && _clock < (Tick)(now() / TICK))
+            _clock = now() / TICK;
+
+        e->_expires = ticks(deadline);
+        place(e);
+        _size++;
+    }
+
+    void remove(Element * e) {
+        db<Lists>(TRC) << "Timing_Wheel::remove(e=" << e << ")\n";
+
+        if(!e->armed())
+            return;
+        unlink(e);
+        _size--;
+    }
+
+    // Avança o relógio até o instante t e devolve os elementos expirados, ligados por next() (0 no fim).
+    Element * expire(const Microsecond & t) {
+        Tick now = t / TICK;
+        Element * expired = 0;
+
+        if(empty()) {
+            if(_clock <= now)
+                _clock = now + 1;
+            return 0;
+        }
+
+        while(_clock <= now) {
+            unsigned int index = _clock & (ROOT_SIZE - 1);
+
+            // Ao dar a volta no primeiro nível, traz para baixo o próximo slot de cada nível.
+            if(!index)
+                for(unsigned int l = 1; l < LEVELS && !cascade(l); l++);
+
+            Slot * s = &_root[index];
+            while(!s->empty()) {
+                Element * e = s->_next;
+                unlink(e);
+                _size--;
+                e->_next = expired;
+                expired = e;
+            }
+            _clock++;
+
+            if(empty() && _clock <= now)
+                _clock = now + 1;
+        }
+
+        return expired;
+    }
+
+    // Limite inferior do instante do próximo elemento a expirar (só é exato para o primeiro nível).
+    Microsecond next() const {
+        for(unsigned int i = 0; i < ROOT_SIZE; i++) {
+            Tick t = _clock + i;
+            if(i && !(t & (ROOT_SIZE - 1)))
+                return time(t); // próxima cascata.
+            if(!_root[t & (ROOT_SIZE - 1)].empty())
+                return time(t);
+        }
+        return time(_clock + ROOT_SIZE);
+    }
+
+private:
+    void place(Element * e) {
+        Tick expires = e->_expires < _clock ? _clock : e->_expires;
+        Tick delta = expires - _clock;
+        Slot * s;
+
+        if(delta < ROOT_SIZE)
+            s = &_root[expires & (ROOT_SIZE - 1)];
+        else {
+            unsigned int l = 1;
+            while(l < LEVELS - 1 && delta >= (Tick)1 << (ROOT_BITS + l * LEVEL_BITS))
+                l++;
+            if(delta >= (Tick)1 << (ROOT_BITS + l * LEVEL_BITS)) // além do alcance: fica no último slot e volta a descer.
+                expires = _clock + ((Tick)1 << (ROOT_BITS + l * LEVEL_BITS)) - 1;
+            s = &_levels[l - 1][(expires >> (ROOT_BITS + (l - 1) * LEVEL_BITS)) & (LEVEL_SIZE - 1)];
+        }
+
+        e->_prev = s->_prev;
+        e->_next = s;
+        s->_prev->_next = e;
+        s->_prev = e;
+    }
+
+    void unlink(Element * e) {
+        e->_prev->_next = e->_next;
+        e->_next->_prev = e->_prev;
+        e->_prev = 0;
+        e->_next = 0;
+    }
+
+    // Redistribui o slot atual do nível l; devolve o índice dele (0 indica que o nível também deu a volta).
+    unsigned int cascade(unsigned int l) {
+        unsigned int index = (_clock >> (ROOT_BITS + (l - 1) * LEVEL_BITS)) & (LEVEL_SIZE - 1);
+        Slot * s = &_levels[l - 1][index];
+
+        Element * e = s->_next;
+        s->_prev = s;
+        s->_next = s;
+        while(e != s) {
+            Element * n = e->_next;
+            place(e);
+            e = n;
+        }
+
+        return index;
+    }
+
+private:
+    Tick _clock; // próximo tick a ser processado.
+    unsigned int _size;
+    Slot _root[ROOT_SIZE];
+    Slot _levels[LEVELS - 1][LEVEL_SIZE];
+};
+
+__END_API
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef trace_h
+#define trace_h
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "Concurrency/traits.h"
+
+__BEGIN_API
+
+/*
+ * Rastreamento binário do escalonador, para deixar ligado em produção no lugar de db<Thread>(TRC).
+ * Com Traits<Trace>::enabled, cada evento (troca de contexto, yield, sleep, acordar, p/v de semáforo, criação e
+ * término de thread) grava um registro de tamanho fixo, com o contador de ciclos do processador, no buffer
+ * circular do worker em que ocorreu; sem, os pontos de rastreamento não geram código.
+ * Cada buffer só é escrito pelo seu worker (sem travas nem operações atômicas) e guarda os últimos
+ * Traits<Trace>::entries eventos. dump() os exporta no formato JSON de eventos do Chrome (chrome://tracing),
+ * que o Perfetto (ui.perfetto.dev) também abre: cada worker é uma linha com as threads que executou.
+ * Ao final da execução, os eventos são escritos em Traits<Trace>::file.
+ */
+class Trace
+{
+public:
+    static const bool ENABLED = Traits<Trace>::enabled;
+    static const unsigned int WORKERS = Traits<Thread>::workers;
+    static const unsigned long ENTRIES = ENABLED ? Traits<Trace>::entries : 1; // potência de 2.
+
+    enum Event { CREATE, EXIT, SWITCH, YIELD, SLEEP, WAKEUP, P, V, EVENTS };
+
+    // Registro de um evento. thread é o id da thread do evento (em SWITCH, a que sai; arg é o id da que entra).
+    struct Record
+    {
+        unsigned long long time;
+        int thread;
+        unsigned short event;
+        unsigned short worker;
+        long arg;
+    };
+
+    static void record(unsigned int worker, Event event, int thread, long arg = 0) {
+        if (!ENABLED)
+            return;
+        Ring & r = _rings[worker];
+        Record & e = _buffers[worker][r.head & (ENTRIES - 1)];
+        e.time = tsc();
+        e.thread = thread;
+        e.event = event;
+        e.worker = worker;
+        e.arg = arg;
+        r.head++;
+    }
+
+    static void init(); // calibra o contador de ciclos (em Thread::init()).
+
+    // Ciclos de tsc() por microssegundo, medidos desde init(); também usado pelas estatísticas de Thread.
+    static double ticks_per_us();
+    static unsigned long long origin() { return _tsc0; } // tsc() em init().
+
+    // Escreve os eventos registrados em path, no formato JSON do Chrome. Devolve false se não conseguir abrir
+    // o arquivo. Com os workers executando, os eventos mais recentes de outro worker podem sair incompletos.
+    static bool dump(const char * path);
+
+    static unsigned long long tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        unsigned long long t;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+        return t;
+#else
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+private:
+    // Uma linha de cache por worker: os workers não disputam as posições de escrita.
+    struct alignas(64) Ring
+    {
+        unsigned long head; // eventos já registrados; a posição é head % ENTRIES.
+    };
+
+    static unsigned long long nanoseconds();
+
+private:
+    static Ring _rings[WORKERS];
+    static Record _buffers[WORKERS][ENTRIES];
+    static unsigned long long _tsc0; // instante da calibração, no contador de ciclos e em nanossegundos.
+    static unsigned long long _ns0;
+};
+
+__END_API
+
+#endif
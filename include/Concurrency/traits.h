@@ -17,6 +17,19 @@ class System;
 class Main;
 class Lists;
 class Semaphore;
+class Mutex;
+class Condition;
+class RWLock;
+class Latch;
+class Wait_Group;
+class Barrier;
+class Channel_Common;
+class Select;
+class Trace;
+class Stack_Pool;
+class Spin;
+class IO;
+class Helper_Pool;
 
 // Declaracao da classe Traits
 template<typename T> struct Traits {
@@ -25,6 +38,9 @@ template<typename T> struct Traits {
 
 template<> struct Traits<CPU> {
     static const int STACK_SIZE = 80*1024;
+    // true: troca de contexto em assembly, salvando apenas os registradores callee-saved e o stack pointer.
+    // false: usa getcontext/setcontext/swapcontext da glibc (fallback; também usado em arquiteturas sem suporte).
+    static const bool fast_switch = true;
     static const bool debugged = false;
 };
 
@@ -34,9 +50,41 @@ template <> struct Traits<Debug> : public Traits<void> {
     static const bool warning = false;
     static const bool info = false;
     static const bool trace = false;
+    // true: as mensagens vão para uma fila sem trava e uma thread do kernel as escreve em lotes (writev);
+    // false: cada mensagem é escrita com um write() por quem a gerou.
+    static const bool asynchronous = true;
+    static const unsigned int buffer = 256; // bytes por mensagem (uma mensagem maior é dividida).
+    static const unsigned int records = 1024; // capacidade da fila (potência de 2); cheia, a mensagem é escrita direto.
+    static const unsigned int batch = 64; // mensagens por writev().
+    static const int fd = 1; // descritor de saída.
 };
 
 template <> struct Traits<Thread> : public Traits<void> {
+    // Número de threads do kernel (workers) que executam as Threads (modelo M:N).
+    // Com 1, todo o escalonamento acontece na thread que chamou System::init, sem nenhuma trava.
+    static const unsigned int workers = 1;
+    // Fila de prontos (com um único worker) em Pairing_Heap: insert O(1) e remoções O(log n).
+    // false: Ordered_List, com insert linear no número de threads prontas.
+    static const bool ready_heap = true;
+    // Troca direta entre threads (yield, handoff do semáforo, fim do join) sem passar pelo despachante
+    // quando já há uma thread pronta (padrão). false restaura o caminho anterior: toda troca passa pelo
+    // despachante (duas trocas de contexto).
+    static const bool direct_switch = true;
+    // Preempção por tempo: cada worker arma um temporizador (timer_create) que, a cada `quantum`
+    // microssegundos, envia SIGALRM e força um yield() da thread em execução.
+    static const bool preemptive = false;
+    static const unsigned int quantum = 10000;
+    // Resolução, em microssegundos, dos temporizadores de sleep_for/sleep_until e das esperas com prazo.
+    static const unsigned int tick = 1000;
+    // Passadas seguidas sem threads prontas (cada uma com pause e sched_yield) em que um despachante espera
+    // ocupado antes de dormir no kernel (futex). Dormindo, acorda quando outro worker insere uma thread
+    // pronta em sua fila, ou a cada `tick` para conferir prazos e descritores.
+    static const unsigned int idle_spins = 100;
+    // Estatísticas por thread (despachos, trocas voluntárias e involuntárias) e dos despachantes, ver Thread::stats().
+    // Com stats_time, também o tempo de cada thread em cada estado (execução, pronta, esperando, suspensa), ao custo
+    // de uma leitura do contador de ciclos por troca de contexto e por thread acordada (~12 ns cada, medido).
+    static const bool stats = true;
+    static const bool stats_time = false;
     static const bool debugged = false;
 };
 
@@ -53,6 +101,90 @@ template <> struct Traits<Lists> : public Traits<void> {
 };
 
 template <> struct Traits<Semaphore> : public Traits<void> {
+    // Com mais de um worker, p() espera ocupada (pause) por até `spin_max` iterações antes de dormir.
+    // O limite efetivo se adapta à média das esperas recentes de cada semáforo.
+    static const bool spin = true;
+    static const int spin_max = 1000;
+    // v() troca diretamente para a thread que recebe o semáforo (passagem de bastão).
+    // false: ela só é colocada na fila de prontos, e quem chamou v() continua executando.
+    static const bool handoff = true;
+    static const bool debugged = false;
+};
+
+template <> struct Traits<IO> : public Traits<void> {
+    static const int events = 64; // eventos lidos por epoll_wait.
+    // Com threads prontas, o epoll é consultado (sem bloquear) no máximo uma vez a cada `interval` microssegundos.
+    static const int interval = 1000;
+    // pread/pwrite pelo io_uring, com uma fila de submissão de ring_entries entradas.
+    // false (ou kernel sem io_uring): as operações são executadas no Helper_Pool.
+    static const bool uring = true;
+    static const unsigned int ring_entries = 256;
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Helper_Pool> : public Traits<void> {
+    static const unsigned int helpers = 4; // threads do kernel auxiliares, criadas no primeiro uso.
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Mutex> : public Traits<void> {
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Condition> : public Traits<void> {
+    static const bool debugged = false;
+};
+
+template <> struct Traits<RWLock> : public Traits<void> {
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Latch> : public Traits<void> {
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Wait_Group> : public Traits<void> {
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Barrier> : public Traits<void> {
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Channel_Common> : public Traits<void> {
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Select> : public Traits<void> {
+    static const int cases = 8; // casos por Select.
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Trace> : public Traits<void> {
+    // Rastreamento binário dos eventos do escalonador (ver Trace::dump()). false: os pontos de rastreamento
+    // não geram código.
+    static const bool enabled = false;
+    static const unsigned long entries = 65536; // eventos guardados por worker (potência de 2).
+    static constexpr const char * file = "trace.json"; // escrito ao final da execução (0: só com Trace::dump()).
+    static const bool debugged = false;
+};
+
+template <> struct Traits<Stack_Pool> : public Traits<void> {
+    static const unsigned int prewarm = 16; // pilhas mapeadas antecipadamente em Thread::init.
+    static const unsigned int max_cached = 1024; // pilhas livres mantidas para reuso; as excedentes são desmapeadas.
+    // Pilhas preguiçosas: cada pilha reserva `reserve` bytes de espaço virtual (MAP_NORESERVE) no lugar de
+    // Traits<CPU>::STACK_SIZE, e só as páginas tocadas ocupam memória. As páginas são devolvidas ao SO
+    // quando a thread termina ou fica mais de `trim_delay` microssegundos dormindo/suspensa.
+    // Cada pilha usa dois mapeamentos (guarda + pilha); para centenas de milhares de threads é preciso
+    // aumentar vm.max_map_count.
+    static const bool lazy = false;
+    static const unsigned int reserve = 1024*1024;
+    static const int trim_delay = 100000;
+    static const bool madv_free = false; // MADV_FREE (mais barato, devolução adiada pelo kernel) em vez de MADV_DONTNEED.
+    // Estatística de pilha: pinta cada pilha com um padrão canário na criação do contexto e, ao término
+    // de cada thread, informa o pico de uso em db<Thread>(INF). Toca todas as páginas da pilha, então não
+    // combina com lazy.
+    static const bool paint = false;
     static const bool debugged = false;
 };
 
@@ -0,0 +1,38 @@
+#ifndef wait_group_h
+#define wait_group_h
+
+#include "Concurrency/thread.h"
+#include "Concurrency/traits.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/list.h"
+
+__BEGIN_API
+
+/*
+ * Grupo de espera (como o sync.WaitGroup de Go): add(n) antes de criar n threads, done() ao fim de cada
+ * uma e wait() para esperar todas com um único sleep, em vez de um join() por thread. Ao zerar o contador,
+ * todas as threads esperando são acordadas de uma vez; o grupo pode então ser reutilizado. Um done() a mais
+ * deixa o contador negativo: as esperas também são liberadas, com um aviso.
+ */
+class Wait_Group
+{
+public:
+    typedef Ordered_List<Thread> Asleep_Queue;
+
+    Wait_Group(): _count(0) {}
+    ~Wait_Group();
+
+    void add(int n = 1);
+    void done() { add(-1); }
+    void wait();
+
+    int count() { return _count; }
+
+private:
+    Asleep_Queue _asleep;
+    volatile int _count;
+};
+
+__END_API
+
+#endif
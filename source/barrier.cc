@@ -0,0 +1,38 @@
+#include "Concurrency/debug.h"
+#include "Concurrency/traits.h"
+
+#include "Concurrency/barrier.h"
+
+__BEGIN_API
+
+bool Barrier::arrive_and_wait()
+{
+    db<Barrier>(TRC) << "Barrier::arrive_and_wait called." << "\n";
+    Thread::int_disable();
+    Thread::lock();
+
+    if (++_arrived < _count)
+    {
+        Thread::running()->sleep(&_asleep);
+        Thread::int_enable();
+        return false;
+    }
+
+    // Última a chegar: abre a barreira para todas de uma vez e a prepara para a próxima fase.
+    _arrived = 0;
+    _phase++;
+    while (!_asleep.empty())
+        _asleep.remove()->object()->wake();
+
+    Thread::unlock();
+    Thread::int_enable();
+    return true;
+}
+
+Barrier::~Barrier()
+{
+    if (!_asleep.empty())
+        db<Barrier>(WRN) << "Barrier destruída com threads esperando.\n";
+}
+
+__END_API
@@ -0,0 +1,43 @@
+#include "Concurrency/debug.h"
+#include "Concurrency/traits.h"
+
+#include "Concurrency/channel.h"
+#include "Concurrency/select.h"
+
+__BEGIN_API
+
+bool Channel_Common::wait(Wait_List & list, Waiter * waiter)
+{
+    list.insert(&waiter->link);
+    waiter->thread->sleep(0);
+
+    // Acordada por done() (item zerado) ou por shut().
+    return !waiter->item;
+}
+
+void Channel_Common::wake(Waiter * waiter)
+{
+    if (waiter->select)
+        waiter->select->fire(waiter);
+    else
+        waiter->thread->wake();
+}
+
+void Channel_Common::shut()
+{
+    _closed = true;
+
+    // Todos acordam de uma vez, sem ceder o processador.
+    while (!_receivers.empty())
+        wake(next(_receivers));
+    while (!_senders.empty())
+        wake(next(_senders));
+}
+
+Channel_Common::~Channel_Common()
+{
+    if (!_senders.empty() || !_receivers.empty())
+        db<Channel_Common>(WRN) << "Channel destruído com threads esperando.\n";
+}
+
+__END_API
@@ -0,0 +1,73 @@
+#include "Concurrency/debug.h"
+#include "Concurrency/traits.h"
+
+#include "Concurrency/condition.h"
+
+__BEGIN_API
+
+void Condition::wait(Mutex & mutex)
+{
+    sleep(mutex, 0);
+}
+
+bool Condition::wait(Mutex & mutex, const Thread::Microsecond & timeout)
+{
+    if (timeout <= 0)
+        return false;
+
+    return sleep(mutex, Thread::now() + timeout);
+}
+
+bool Condition::sleep(Mutex & mutex, const Thread::Microsecond & deadline)
+{
+    db<Condition>(TRC) << "Condition::wait called." << "\n";
+    Thread * running = Thread::running();
+    if (mutex._owner != running)
+    {
+        db<Condition>(WRN) << "Condition::wait() sem o mutex.\n";
+        return false;
+    }
+
+    // Libera o mutex e entra em _asleep com a trava adquirida: um signal() não passa entre os dois.
+    unsigned int depth = mutex._depth;
+    Thread::int_disable();
+    Thread::lock();
+    mutex.release();
+    bool signaled = running->sleep(&_asleep, deadline);
+    Thread::int_enable();
+
+    mutex.lock();
+    mutex._depth = depth;
+
+    return signaled;
+}
+
+void Condition::signal()
+{
+    db<Condition>(TRC) << "Condition::signal called." << "\n";
+    Thread::int_disable();
+    Thread::lock();
+    if (!_asleep.empty())
+        _asleep.remove()->object()->wake();
+    Thread::unlock();
+    Thread::int_enable();
+}
+
+void Condition::broadcast()
+{
+    db<Condition>(TRC) << "Condition::broadcast called." << "\n";
+    // Todas de uma vez, sem ceder o processador entre uma e outra.
+    Thread::int_disable();
+    Thread::lock();
+    while (!_asleep.empty())
+        _asleep.remove()->object()->wake();
+    Thread::unlock();
+    Thread::int_enable();
+}
+
+Condition::~Condition()
+{
+    broadcast();
+}
+
+__END_API
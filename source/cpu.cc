@@ -1,35 +1,211 @@
 #include "Concurrency/cpu.h"
 #include <iostream>
+#include <cstdlib>
+
+// Troca de contexto em assembly.
+// cpu_switch_context(from, to) empilha os registradores callee-saved da ABI, guarda o stack pointer
+// em *from, carrega to como novo stack pointer e desempilha os registradores do contexto de destino.
+// Diferente de swapcontext, não salva a máscara de sinais (sem chamada de sistema) nem o ucontext_t inteiro.
+// cpu_context_trampoline é o "endereço de retorno" do quadro inicial montado por prepareFrame:
+// chama launch(closure) e, caso a função da thread retorne, chama finish (equivalente a uc_link = 0).
+extern "C" void cpu_switch_context(void **from, void *to);
+extern "C" void cpu_context_trampoline();
+
+#if defined(__x86_64__)
+
+// Quadro salvo (do topo da pilha para cima): mxcsr/x87 cw, r15, r14, r13, r12, rbx, rbp, endereço de retorno.
+asm(
+    ".text\n"
+    ".p2align 4\n"
+    ".type cpu_switch_context, @function\n"
+    "cpu_switch_context:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size cpu_switch_context, .-cpu_switch_context\n"
+    ".p2align 4\n"
+    ".type cpu_context_trampoline, @function\n"
+    "cpu_context_trampoline:\n"
+    "    movq %r13, %rdi\n"
+    "    callq *%r12\n"
+    "    callq *%r14\n"
+    "    hlt\n"
+    ".size cpu_context_trampoline, .-cpu_context_trampoline\n"
+);
+
+#elif defined(__aarch64__)
+
+// Quadro salvo (160 bytes): x19-x28, x29 (fp), x30 (lr, endereço de retorno) e d8-d15.
+asm(
+    ".text\n"
+    ".p2align 4\n"
+    ".type cpu_switch_context, %function\n"
+    "cpu_switch_context:\n"
+    "    sub sp, sp, #160\n"
+    "    stp x19, x20, [sp, #0]\n"
+    "    stp x21, x22, [sp, #16]\n"
+    "    stp x23, x24, [sp, #32]\n"
+    "    stp x25, x26, [sp, #48]\n"
+    "    stp x27, x28, [sp, #64]\n"
+    "    stp x29, x30, [sp, #80]\n"
+    "    stp d8, d9, [sp, #96]\n"
+    "    stp d10, d11, [sp, #112]\n"
+    "    stp d12, d13, [sp, #128]\n"
+    "    stp d14, d15, [sp, #144]\n"
+    "    mov x2, sp\n"
+    "    str x2, [x0]\n"
+    "    mov sp, x1\n"
+    "    ldp x19, x20, [sp, #0]\n"
+    "    ldp x21, x22, [sp, #16]\n"
+    "    ldp x23, x24, [sp, #32]\n"
+    "    ldp x25, x26, [sp, #48]\n"
+    "    ldp x27, x28, [sp, #64]\n"
+    "    ldp x29, x30, [sp, #80]\n"
+    "    ldp d8, d9, [sp, #96]\n"
+    "    ldp d10, d11, [sp, #112]\n"
+    "    ldp d12, d13, [sp, #128]\n"
+    "    ldp d14, d15, [sp, #144]\n"
+    "    add sp, sp, #160\n"
+    "    ret\n"
+    ".size cpu_switch_context, .-cpu_switch_context\n"
+    ".p2align 4\n"
+    ".type cpu_context_trampoline, %function\n"
+    "cpu_context_trampoline:\n"
+    "    mov x0, x20\n"
+    "    blr x19\n"
+    "    blr x21\n"
+    "    brk #0\n"
+    ".size cpu_context_trampoline, .-cpu_context_trampoline\n"
+);
+
+#else
+
+// Sem suporte em assembly: FAST_SWITCH é sempre false e estas funções nunca são chamadas.
+extern "C" void cpu_switch_context(void **from, void *to) { abort(); }
+extern "C" void cpu_context_trampoline() { abort(); }
+
+#endif
 
 __BEGIN_API
 
 using namespace std;
 
+// Chamada pelo trampolim caso a função de uma thread retorne, assim como acontece com uc_link = 0.
+static void finish()
+{
+    exit(0);
+}
+
+void *CPU::Context::prepareFrame(char *top, void (*launch)(void *), void *closure)
+{
+    void **sp = (void **)top;
+
+#if defined(__x86_64__)
+    *--sp = (void *)&cpu_context_trampoline; // endereço de retorno
+    *--sp = 0;                               // rbp
+    *--sp = 0;                               // rbx
+    *--sp = (void *)launch;                  // r12
+    *--sp = closure;                         // r13
+    *--sp = (void *)&finish;                 // r14
+    *--sp = 0;                               // r15
+    *--sp = (void *)((0x037FUL << 32) | 0x1F80UL); // x87 cw e mxcsr padrões da ABI
+#elif defined(__aarch64__)
+    sp -= 20;
+    for (int i = 0; i < 20; i++)
+        sp[i] = 0;
+    sp[0] = (void *)launch;                  // x19
+    sp[1] = closure;                         // x20
+    sp[2] = (void *)&finish;                 // x21
+    sp[11] = (void *)&cpu_context_trampoline; // x30 (lr)
+#endif
+
+    return sp;
+}
+
 void CPU::Context::save()
 {
+    // Na troca em assembly o contexto é salvo pela própria switch_context.
+    if (FAST_SWITCH)
+        return;
+
     ucontext_t *contextToSavePtr = &this->_context;
     getcontext(contextToSavePtr);
 }
 
 void CPU::Context::load()
 {
+    if (FAST_SWITCH) {
+        void *discarded; // o contexto atual é abandonado.
+        cpu_switch_context(&discarded, this->_sp);
+        return;
+    }
+
     ucontext_t *contextToLoadPtr = &this->_context;
     setcontext(contextToLoadPtr);
 
 }
 
+void CPU::Context::trim()
+{
+    if (!this->_stack)
+        return;
+
+    void *sp;
+    if (FAST_SWITCH)
+        sp = this->_sp;
+    else
+#if defined(__x86_64__)
+        sp = (void *)this->_context.uc_mcontext.gregs[REG_RSP];
+#elif defined(__aarch64__)
+        sp = (void *)this->_context.uc_mcontext.sp;
+#else
+        return;
+#endif
+
+    Stack_Pool::trim(this->_stack, sp);
+}
+
+unsigned int CPU::Context::stack_usage() const
+{
+    if (!Stack_Pool::PAINT || !this->_stack)
+        return 0;
+
+    return Stack_Pool::usage(this->_stack, this->_stack_size);
+}
+
 CPU::Context::~Context()
 {
     if (this->_stack) // Se o valor apontado por _stack for diferente de 0, esse valor não será destruído no destructor padrão.
-                           // Embora o ponteiro seja destruído, o valor apontado não é. 
+                           // Embora o ponteiro seja destruído, o valor apontado não é. Devolve a pilha ao pool.
     {
-        delete this->_stack;
+        Stack_Pool::free(this->_stack, this->_stack_size);
     }
 }
 
 int CPU::switch_context(Context *from, Context *to)
 {   
-    if (from && to ){
+    if (from && to && Context::FAST_SWITCH){
+        cpu_switch_context(&from->_sp, to->_sp);
+        return 0;
+    } else if (from && to ){
         ucontext_t *currentContextPtr = &from->_context;
         ucontext_t *nextContextPtr = &to->_context;
         int swapWorked = swapcontext(currentContextPtr, nextContextPtr);
@@ -39,20 +215,4 @@ int CPU::switch_context(Context *from, Context *to)
     }
 }
 
-int CPU::finc(volatile int & number)
-{
-    register int result = 1;
-    asm("lock xadd %0, %2" : "=a"(result) : "a"(result), "m"(number));
-
-    return result;
-}
-
-int CPU::fdec(volatile int & number)
-{
-    register int result = -1;
-    asm("lock xadd %0, %2" : "=a"(result) : "a"(result), "m"(number));
-
-    return result;
-}
-
 __END_API
@@ -1,3 +1,12 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
 #include "Concurrency/debug.h"
 
 __BEGIN_API
@@ -5,4 +14,242 @@ __BEGIN_API
 Debug::Begl Debug::begl;
 Debug::Err Debug::error;
 
-__END_API
\ No newline at end of file
+Debug::Record Debug::_records[Debug::RECORDS];
+alignas(64) volatile unsigned long Debug::_tail = 0;
+alignas(64) volatile unsigned long Debug::_head = 0;
+volatile int Debug::_draining = 0;
+volatile int Debug::_idle = 0;
+volatile int Debug::_started = 0;
+
+static_assert((Traits<Debug>::records & (Traits<Debug>::records - 1)) == 0, "Traits<Debug>::records deve ser potência de 2");
+
+static void futex(volatile int * word, int op, int value)
+{
+    syscall(SYS_futex, word, op | FUTEX_PRIVATE_FLAG, value, 0, 0, 0);
+}
+
+// Escreve tudo, repetindo em escritas parciais.
+static void write_all(const char * text, size_t length)
+{
+    while (length)
+    {
+        ssize_t n = write(Traits<Debug>::fd, text, length);
+        if (n <= 0)
+            return;
+        text += n;
+        length -= n;
+    }
+}
+
+Debug & Debug::text(const char * s, unsigned int n)
+{
+    while (n)
+    {
+        // Mensagem maior que o buffer: publica o que já foi formatado e continua do início.
+        if (_length == BUFFER)
+        {
+            publish();
+            _length = 0;
+        }
+        unsigned int k = n < BUFFER - _length ? n : BUFFER - _length;
+        memcpy(_buffer + _length, s, k);
+        _length += k;
+        s += k;
+        n -= k;
+    }
+    return *this;
+}
+
+Debug & Debug::number(unsigned long long n, bool negative)
+{
+    char digits[21];
+    char * p = digits + sizeof(digits);
+    do
+        *--p = '0' + n % 10;
+    while (n /= 10);
+    if (negative)
+        *--p = '-';
+    return text(p, digits + sizeof(digits) - p);
+}
+
+// Como o ostream: 0x seguido do endereço em hexadecimal, ou 0 para o ponteiro nulo.
+Debug & Debug::pointer(const void * p)
+{
+    unsigned long n = (unsigned long)p;
+    if (!n)
+        return text("0", 1);
+    char digits[2 + 2 * sizeof(n)];
+    char * q = digits + sizeof(digits);
+    for (; n; n >>= 4)
+        *--q = "0123456789abcdef"[n & 0xf];
+    *--q = 'x';
+    *--q = '0';
+    return text(q, digits + sizeof(digits) - q);
+}
+
+Debug & Debug::operator<<(double d)
+{
+    char digits[32];
+    int n = snprintf(digits, sizeof(digits), "%g", d);
+    return text(digits, n < (int)sizeof(digits) ? n : sizeof(digits) - 1);
+}
+
+void Debug::publish()
+{
+    if (!Traits<Debug>::asynchronous)
+    {
+        write_all(_buffer, _length);
+        return;
+    }
+
+    // Sem pthread_once: uma thread preemptada dentro dele bloquearia as outras do mesmo worker.
+    if (!__atomic_load_n(&_started, __ATOMIC_RELAXED) && !__atomic_exchange_n(&_started, 1, __ATOMIC_RELAXED))
+        start();
+
+    // Fila cheia: escreve direto (a mensagem sai fora de ordem, mas não se perde).
+    if (!enqueue(_buffer, _length))
+    {
+        write_all(_buffer, _length);
+        return;
+    }
+
+    // Um erro é escrito antes de db<>() retornar, a menos que outra thread já esteja esvaziando a fila (ela o
+    // escreverá): esperar por uma Thread preemptada no mesmo worker nunca terminaria.
+    if (_error && drain_all(false))
+        return;
+
+    // Pareado com o do drenador antes de dormir: ou ele vê a mensagem, ou esta thread o vê ocioso.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&_idle, __ATOMIC_RELAXED) && __atomic_exchange_n(&_idle, 0, __ATOMIC_RELAXED))
+        futex(&_idle, FUTEX_WAKE, 1);
+}
+
+bool Debug::enqueue(const char * text, unsigned int length)
+{
+    unsigned long position = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+    Record * r;
+    for (;;)
+    {
+        r = &_records[position & (RECORDS - 1)];
+        long diff = (long)(__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) - lap(position));
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&_tail, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+            return false; // a posição ainda guarda uma mensagem de RECORDS atrás: fila cheia.
+        else
+            position = __atomic_load_n(&_tail, __ATOMIC_RELAXED);
+    }
+
+    memcpy(r->text, text, length);
+    r->length = length;
+    __atomic_store_n(&r->sequence, lap(position) + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Só uma thread esvazia a fila por vez (_draining): as posições só são devolvidas aos produtores
+// depois do writev(), que lê o texto diretamente delas.
+bool Debug::drain()
+{
+    struct iovec batch[BATCH];
+    unsigned long head = _head;
+    unsigned int n = 0;
+    for (; n < BATCH; n++)
+    {
+        Record * r = &_records[(head + n) & (RECORDS - 1)];
+        if (__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) != lap(head + n) + 1)
+            break;
+        batch[n].iov_base = r->text;
+        batch[n].iov_len = r->length;
+    }
+    if (!n)
+        return false;
+
+    struct iovec * v = batch;
+    unsigned int count = n;
+    while (count)
+    {
+        ssize_t written = writev(Traits<Debug>::fd, v, count);
+        if (written <= 0)
+            break;
+        // Escrita parcial: avança pelos vetores já escritos.
+        while (count && (size_t)written >= v->iov_len)
+        {
+            written -= v->iov_len;
+            v++;
+            count--;
+        }
+        if (count)
+        {
+            v->iov_base = (char *)v->iov_base + written;
+            v->iov_len -= written;
+        }
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+        __atomic_store_n(&_records[(head + i) & (RECORDS - 1)].sequence, lap(head + i) + RECORDS, __ATOMIC_RELEASE);
+    _head = head + n;
+    return true;
+}
+
+bool Debug::drain_all(bool wait)
+{
+    while (__atomic_exchange_n(&_draining, 1, __ATOMIC_ACQUIRE))
+    {
+        if (!wait)
+            return false;
+        sched_yield();
+    }
+    bool drained = false;
+    while (drain())
+        drained = true;
+    __atomic_store_n(&_draining, 0, __ATOMIC_RELEASE);
+    return wait || drained;
+}
+
+void Debug::flush()
+{
+    if (Traits<Debug>::asynchronous)
+        drain_all(true);
+}
+
+void * Debug::drainer(void *)
+{
+    for (;;)
+    {
+        if (drain_all(false))
+            continue;
+
+        // Fila vazia: anuncia que vai dormir e confere de novo antes, para não perder uma mensagem
+        // publicada entre o drain() e o futex.
+        __atomic_store_n(&_idle, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        Record * r = &_records[_head & (RECORDS - 1)];
+        if (__atomic_load_n(&r->sequence, __ATOMIC_ACQUIRE) == lap(_head) + 1)
+        {
+            __atomic_store_n(&_idle, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+        futex(&_idle, FUTEX_WAIT, 1);
+    }
+
+    return 0;
+}
+
+void Debug::start()
+{
+    // O drenador não recebe os sinais dos workers (ex.: SIGALRM da preempção).
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    pthread_t thread;
+    pthread_create(&thread, 0, &Debug::drainer, 0);
+    pthread_detach(thread);
+    pthread_sigmask(SIG_SETMASK, &old, 0);
+
+    atexit(&Debug::flush);
+}
+
+__END_API
@@ -0,0 +1,98 @@
+#include "Concurrency/cpu.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/io.h"
+#include "Concurrency/helper_pool.h"
+
+__BEGIN_API
+
+pthread_mutex_t Helper_Pool::_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t Helper_Pool::_cond = PTHREAD_COND_INITIALIZER;
+pthread_once_t Helper_Pool::_once = PTHREAD_ONCE_INIT;
+Helper_Pool::Job * Helper_Pool::_head = 0;
+Helper_Pool::Job * Helper_Pool::_tail = 0;
+Helper_Pool::Job * Helper_Pool::_done = 0;
+unsigned int Helper_Pool::_helpers = 0;
+
+void Helper_Pool::execute(Job * job)
+{
+    db<Helper_Pool>(TRC) << "Helper_Pool::execute(job=" << job << ")\n";
+
+    // Os auxiliares são criados antes da trava do escalonador, que os outros workers esperariam girando
+    // durante as chamadas ao SO. Com as interrupções desabilitadas, nenhuma Thread do mesmo worker entra no
+    // pthread_once enquanto esta está dentro dele; a de outro worker espera no kernel.
+    Thread::int_disable();
+    pthread_once(&_once, &Helper_Pool::start);
+    if (!_helpers)
+    {
+        // Nenhum auxiliar pôde ser criado: ninguém executaria o job. Executa-o aqui, bloqueando o worker.
+        Thread::int_enable();
+        job->run();
+        return;
+    }
+
+    Thread::lock();
+    IO::init();
+
+    job->_thread = Thread::running();
+    job->_next = 0;
+
+    pthread_mutex_lock(&_mutex);
+    if (_tail)
+        _tail->_next = job;
+    else
+        _head = job;
+    _tail = job;
+    pthread_cond_signal(&_cond);
+    pthread_mutex_unlock(&_mutex);
+
+    // Como em IO::wait(): a Thread só é acordada (por IO::complete()) depois de ter saído do processador.
+    CPU::finc(IO::_waiting);
+    Thread::running()->sleep(0);
+    CPU::fdec(IO::_waiting);
+
+    Thread::int_enable();
+}
+
+void Helper_Pool::start()
+{
+    for (unsigned int i = 0; i < Traits<Helper_Pool>::helpers; i++)
+    {
+        pthread_t helper;
+        int error = pthread_create(&helper, 0, &Helper_Pool::helper, 0);
+        if (error)
+        {
+            db<Helper_Pool>(WRN) << "Helper_Pool: pthread_create falhou (" << error << "), " << _helpers << " auxiliares.\n";
+            break;
+        }
+        pthread_detach(helper);
+        _helpers++;
+    }
+}
+
+void * Helper_Pool::helper(void *)
+{
+    for (;;)
+    {
+        pthread_mutex_lock(&_mutex);
+        while (!_head)
+            pthread_cond_wait(&_cond, &_mutex);
+        Job * job = _head;
+        _head = job->_next;
+        if (!_head)
+            _tail = 0;
+        pthread_mutex_unlock(&_mutex);
+
+        job->run();
+
+        Job * top = __atomic_load_n(&_done, __ATOMIC_RELAXED);
+        do
+            job->_next = top;
+        while (!__atomic_compare_exchange_n(&_done, &top, job, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+        IO::signal();
+    }
+
+    return 0;
+}
+
+__END_API
@@ -0,0 +1,383 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "Concurrency/cpu.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/io.h"
+
+__BEGIN_API
+
+int IO::_epoll = -1;
+int IO::_event = -1;
+int IO::_completion = -1;
+Ring IO::_ring;
+volatile int IO::_waiting = 0;
+volatile IO::Microsecond IO::_last_check = 0;
+std::vector<IO::Descriptor *> IO::_descriptors;
+
+ssize_t IO::read(int fd, void * buf, size_t count)
+{
+    Descriptor * desc = descriptor(fd);
+    for (;;)
+    {
+        unsigned int sequence = desc ? desc->sequence[IN] : 0;
+        ssize_t r = ::read(fd, buf, count);
+        if (r >= 0 || !desc || (errno != EAGAIN && errno != EWOULDBLOCK))
+            return r;
+        wait(desc, IN, sequence);
+    }
+}
+
+ssize_t IO::write(int fd, const void * buf, size_t count)
+{
+    Descriptor * desc = descriptor(fd);
+    for (;;)
+    {
+        unsigned int sequence = desc ? desc->sequence[OUT] : 0;
+        ssize_t r = ::write(fd, buf, count);
+        if (r >= 0 || !desc || (errno != EAGAIN && errno != EWOULDBLOCK))
+            return r;
+        wait(desc, OUT, sequence);
+    }
+}
+
+int IO::accept(int fd, sockaddr * addr, socklen_t * addrlen)
+{
+    Descriptor * desc = descriptor(fd);
+    for (;;)
+    {
+        unsigned int sequence = desc ? desc->sequence[IN] : 0;
+        int r = ::accept(fd, addr, addrlen);
+        if (r >= 0 || !desc || (errno != EAGAIN && errno != EWOULDBLOCK))
+            return r;
+        wait(desc, IN, sequence);
+    }
+}
+
+int IO::connect(int fd, const sockaddr * addr, socklen_t addrlen)
+{
+    Descriptor * desc = descriptor(fd);
+    int r = ::connect(fd, addr, addrlen);
+    if (r == 0 || !desc || errno != EINPROGRESS)
+        return r;
+
+    // Conexão em andamento: termina quando o socket fica pronto para escrita.
+    if (poll(fd, POLLOUT) < 0)
+        return -1;
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+        return -1;
+    if (error)
+    {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
+
+int IO::poll(int fd, short events, const Microsecond & timeout)
+{
+    Descriptor * desc = descriptor(fd);
+    Microsecond deadline = timeout > 0 ? Thread::now() + timeout : 0;
+    for (;;)
+    {
+        unsigned int sequence = desc ? desc->sequence[ANY] : 0;
+        pollfd p = { fd, events, 0 };
+        int r = ::poll(&p, 1, 0);
+        if (r != 0)
+            return r < 0 ? -1 : p.revents;
+        if (!desc || timeout == 0)
+            return 0;
+        if (!wait(desc, ANY, sequence, deadline))
+            return 0;
+    }
+}
+
+int IO::close(int fd)
+{
+    Thread::int_disable();
+    Thread::lock();
+
+    Descriptor * desc = (fd >= 0 && (unsigned int)fd < _descriptors.size()) ? _descriptors[fd] : 0;
+    if (desc && desc->registered)
+        epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, 0);
+    int r = ::close(fd);
+
+    // Quem ainda espera pelo descritor acorda e recebe o erro da chamada refeita (EBADF).
+    if (desc)
+    {
+        desc->registered = false;
+        for (int d = 0; d < DIRECTIONS; d++)
+            wake(desc, Direction(d));
+    }
+
+    Thread::unlock();
+    Thread::int_enable();
+
+    return r;
+}
+
+ssize_t IO::pread(int fd, void * buf, size_t count, off_t offset)
+{
+    Request request(IORING_OP_READ, fd, buf, count, offset);
+    return submit(&request);
+}
+
+ssize_t IO::pwrite(int fd, const void * buf, size_t count, off_t offset)
+{
+    Request request(IORING_OP_WRITE, fd, const_cast<void *>(buf), count, offset);
+    return submit(&request);
+}
+
+ssize_t IO::submit(Request * request)
+{
+    Thread::int_disable();
+    Thread::lock();
+    init();
+
+    // Fila de submissão cheia: envia o que já está nela. Se o kernel não aceitar nada (ex.: EBUSY com a fila
+    // de conclusão cheia, que ninguém esvazia enquanto esta thread tem a trava), a requisição vai para os
+    // auxiliares em vez de insistir com a trava adquirida e as interrupções desabilitadas.
+    io_uring_sqe * sqe = 0;
+    if (_ring.ready())
+        while (!(sqe = _ring.sqe()) && _ring.submit() > 0);
+
+    if (sqe)
+    {
+        sqe->opcode = request->opcode;
+        sqe->fd = request->fd;
+        sqe->addr = reinterpret_cast<unsigned long>(request->buf);
+        sqe->len = request->count;
+        sqe->off = request->offset;
+        sqe->user_data = reinterpret_cast<unsigned long>(request);
+        _ring.push();
+
+        // A submissão só vai ao kernel em flush(), junto com a das demais threads que dormirem antes dele.
+        request->_thread = Thread::running();
+        CPU::finc(_waiting);
+        Thread::running()->sleep(0);
+        CPU::fdec(_waiting);
+
+        Thread::int_enable();
+    }
+    else
+    {
+        Thread::unlock();
+        Thread::int_enable();
+
+        Helper_Pool::execute(request);
+    }
+
+    if (request->result < 0)
+    {
+        errno = -request->result;
+        return -1;
+    }
+
+    return request->result;
+}
+
+void IO::Request::run()
+{
+    ssize_t r = opcode == IORING_OP_READ ? ::pread(fd, buf, count, offset) : ::pwrite(fd, buf, count, offset);
+    result = r < 0 ? -errno : r;
+}
+
+void IO::init()
+{
+    if (_epoll >= 0)
+        return;
+
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    _event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    _completion = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    // Os eventfds são identificados pelos valores de data.u64, que nunca coincidem com um Descriptor *.
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = INTERRUPT;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _event, &ev);
+    ev.data.u64 = COMPLETION;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _completion, &ev);
+
+    if (Traits<IO>::uring && _ring.init(Traits<IO>::ring_entries))
+        _ring.register_eventfd(_completion);
+}
+
+IO::Descriptor * IO::descriptor(int fd)
+{
+    if (fd < 0)
+        return 0;
+
+    Thread::int_disable();
+    Thread::lock();
+
+    init();
+
+    if ((unsigned int)fd >= _descriptors.size())
+        _descriptors.resize(fd + 1, 0);
+    if (!_descriptors[fd])
+        _descriptors[fd] = new Descriptor(fd);
+
+    Descriptor * desc = _descriptors[fd];
+    if (!desc->registered)
+    {
+        // Registra uma única vez as duas direções: com edge-triggered, não é preciso epoll_ctl a cada espera.
+        // Descritores que o epoll não aceita (ex.: arquivos regulares, que nunca bloqueiam) seguem bloqueantes.
+        epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = desc;
+        int flags = fcntl(fd, F_GETFL);
+        if (flags >= 0 && (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev) == 0 || errno == EEXIST))
+        {
+            fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+            desc->registered = true;
+        }
+    }
+    if (!desc->registered)
+        desc = 0;
+
+    Thread::unlock();
+    Thread::int_enable();
+
+    return desc;
+}
+
+bool IO::wait(Descriptor * desc, Direction d, unsigned int sequence, const Microsecond & deadline)
+{
+    db<IO>(TRC) << "IO::wait(fd=" << desc->fd << ",d=" << d << ")\n";
+
+    Thread::int_disable();
+    Thread::lock();
+
+    // O evento pode ter sido consumido por outro worker entre a chamada que falhou e a trava.
+    if (desc->sequence[d] != sequence)
+    {
+        Thread::unlock();
+        Thread::int_enable();
+        return true;
+    }
+
+    CPU::finc(_waiting);
+    bool ok = Thread::running()->sleep(&desc->waiting[d], deadline);
+    CPU::fdec(_waiting);
+
+    Thread::int_enable();
+
+    return ok;
+}
+
+void IO::wake(Descriptor * desc, Direction d)
+{
+    desc->sequence[d]++;
+    while (!desc->waiting[d].empty())
+        desc->waiting[d].remove()->object()->wake();
+}
+
+void IO::check()
+{
+    if (!_waiting)
+        return;
+
+    // Conclusões do anel e do Helper_Pool são vistas sem chamada de sistema.
+    if (completed() && Thread::try_lock())
+    {
+        complete();
+        Thread::unlock();
+    }
+
+    Microsecond now = Thread::now();
+    if (now - _last_check < Traits<IO>::interval)
+        return;
+    _last_check = now;
+
+    flush();
+    react(0);
+}
+
+void IO::flush()
+{
+    if (!_ring.ready() || !_ring.pending() || !Thread::try_lock())
+        return;
+
+    _ring.submit();
+    Thread::unlock();
+}
+
+void IO::complete()
+{
+    if (_ring.ready())
+        _ring.reap([](unsigned long long data, int res) {
+            Request * request = reinterpret_cast<Request *>(data);
+            request->result = res;
+            request->_thread->wake();
+        });
+
+    for (Helper_Pool::Job * job = Helper_Pool::take(); job; )
+    {
+        Helper_Pool::Job * next = job->_next;
+        job->_thread->wake();
+        job = next;
+    }
+}
+
+void IO::signal()
+{
+    eventfd_write(_completion, 1);
+}
+
+void IO::react(const Microsecond & timeout)
+{
+    static const int EVENTS = Traits<IO>::events;
+    epoll_event events[EVENTS];
+
+    int ms = timeout < 0 ? -1 : (int)((timeout + 999) / 1000);
+    int n = epoll_wait(_epoll, events, EVENTS, ms);
+    if (n <= 0)
+        return;
+
+    db<IO>(TRC) << "IO::react(n=" << n << ")\n";
+
+    Thread::lock();
+    for (int i = 0; i < n; i++)
+    {
+        if (events[i].data.u64 == INTERRUPT)
+            continue;
+        if (events[i].data.u64 == COMPLETION)
+        {
+            eventfd_t value;
+            eventfd_read(_completion, &value);
+            complete();
+            continue;
+        }
+
+        Descriptor * desc = reinterpret_cast<Descriptor *>(events[i].data.ptr);
+
+        unsigned int e = events[i].events;
+        if (e & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            wake(desc, IN);
+        if (e & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+            wake(desc, OUT);
+        wake(desc, ANY);
+    }
+    Thread::unlock();
+}
+
+void IO::interrupt()
+{
+    // O eventfd fica legível (nível) e tira de epoll_wait todos os workers.
+    if (_event >= 0)
+    {
+        eventfd_t one = 1;
+        eventfd_write(_event, one);
+    }
+}
+
+__END_API
@@ -0,0 +1,49 @@
+#include "Concurrency/debug.h"
+#include "Concurrency/traits.h"
+
+#include "Concurrency/latch.h"
+
+__BEGIN_API
+
+void Latch::count_down(int n)
+{
+    db<Latch>(TRC) << "Latch::count_down(n=" << n << ") called." << "\n";
+    int count = __atomic_sub_fetch(&_count, n, __ATOMIC_ACQ_REL);
+    if (count > 0)
+        return;
+    if (count < 0)
+        db<Latch>(WRN) << "Latch::count_down: contador negativo (" << count << ").\n";
+
+    // Zerou (ou passou de zero, que wait() também trata como aberto): acorda todas de uma vez, sem ceder o
+    // processador. Um count_down() que parte de um contador já aberto não encontra ninguém dormindo.
+    Thread::int_disable();
+    Thread::lock();
+    while (!_asleep.empty())
+        _asleep.remove()->object()->wake();
+    Thread::unlock();
+    Thread::int_enable();
+}
+
+void Latch::wait()
+{
+    db<Latch>(TRC) << "Latch::wait called." << "\n";
+    if (try_wait())
+        return;
+
+    // A verificação com a trava ordena a inserção em _asleep e o acordar de count_down().
+    Thread::int_disable();
+    Thread::lock();
+    if (_count > 0)
+        Thread::running()->sleep(&_asleep);
+    else
+        Thread::unlock();
+    Thread::int_enable();
+}
+
+Latch::~Latch()
+{
+    if (!_asleep.empty())
+        db<Latch>(WRN) << "Latch destruído com threads esperando.\n";
+}
+
+__END_API
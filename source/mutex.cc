@@ -0,0 +1,94 @@
+#include "Concurrency/cpu.h"
+#include "Concurrency/debug.h"
+#include "Concurrency/traits.h"
+
+#include "Concurrency/mutex.h"
+
+__BEGIN_API
+
+void Mutex::lock()
+{
+    db<Mutex>(TRC) << "Mutex::lock called." << "\n";
+    Thread * running = Thread::running();
+    if (_recursive && _owner == running)
+    {
+        _depth++;
+        return;
+    }
+
+    // Sem disputa, o CAS basta.
+    if (CPU::cas(_state, 0, 1) != 0)
+    {
+        // Marca o mutex como disputado e dorme até que um unlock() acorde esta thread; então disputa de novo.
+        // A troca e a inserção em _asleep acontecem com a trava, assim como o acordar de unlock().
+        Thread::int_disable();
+        Thread::lock();
+        while (CPU::swap(_state, 2) != 0)
+        {
+            running->sleep(&_asleep);
+            Thread::lock();
+        }
+        Thread::unlock();
+        Thread::int_enable();
+    }
+
+    acquired(running);
+}
+
+bool Mutex::try_lock()
+{
+    Thread * running = Thread::running();
+    if (_recursive && _owner == running)
+    {
+        _depth++;
+        return true;
+    }
+
+    if (CPU::cas(_state, 0, 1) != 0)
+        return false;
+
+    acquired(running);
+    return true;
+}
+
+void Mutex::unlock()
+{
+    db<Mutex>(TRC) << "Mutex::unlock called." << "\n";
+    if (_owner != Thread::running())
+    {
+        db<Mutex>(WRN) << "Mutex::unlock() chamado por quem não é o dono.\n";
+        return;
+    }
+
+    if (--_depth)
+        return;
+
+    _owner = 0;
+
+    // Sem threads esperando, a troca basta.
+    if (CPU::swap(_state, 0) == 2)
+    {
+        Thread::int_disable();
+        Thread::lock();
+        if (!_asleep.empty())
+            _asleep.remove()->object()->wake();
+        Thread::unlock();
+        Thread::int_enable();
+    }
+}
+
+void Mutex::release()
+{
+    _owner = 0;
+    _depth = 0;
+    if (CPU::swap(_state, 0) == 2 && !_asleep.empty())
+        _asleep.remove()->object()->wake();
+}
+
+Mutex::~Mutex()
+{
+    if (_owner)
+        db<Mutex>(WRN) << "Mutex destruído enquanto adquirido.\n";
+}
+
+__END_API
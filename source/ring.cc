@@ -0,0 +1,152 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "Concurrency/debug.h"
+#include "Concurrency/ring.h"
+
+__BEGIN_API
+
+Ring::~Ring()
+{
+    if (_fd < 0)
+        return;
+
+    munmap(_sqes, _sqes_size);
+    if (_cq_map != _sq_map)
+        munmap(_cq_map, _cq_map_size);
+    munmap(_sq_map, _sq_map_size);
+    close(_fd);
+}
+
+bool Ring::init(unsigned int entries)
+{
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    int fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0)
+    {
+        db<IO>(WRN) << "Ring::init: io_uring indisponível.\n";
+        return false;
+    }
+
+    // Kernels anteriores ao 5.6 criam o anel mas não têm IORING_OP_READ/WRITE: ficam com os auxiliares.
+    if (!supports(fd, IORING_OP_READ) || !supports(fd, IORING_OP_WRITE))
+    {
+        db<IO>(WRN) << "Ring::init: io_uring sem IORING_OP_READ/WRITE.\n";
+        close(fd);
+        return false;
+    }
+
+    _sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    _cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (_cq_map_size > _sq_map_size)
+            _sq_map_size = _cq_map_size;
+        _cq_map_size = _sq_map_size;
+    }
+
+    _sq_map = mmap(0, _sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (_sq_map == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        _cq_map = _sq_map;
+    else
+    {
+        _cq_map = mmap(0, _cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (_cq_map == MAP_FAILED)
+        {
+            munmap(_sq_map, _sq_map_size);
+            close(fd);
+            return false;
+        }
+    }
+
+    _sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    _sqes = reinterpret_cast<io_uring_sqe *>(mmap(0, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (_sqes == MAP_FAILED)
+    {
+        if (_cq_map != _sq_map)
+            munmap(_cq_map, _cq_map_size);
+        munmap(_sq_map, _sq_map_size);
+        close(fd);
+        return false;
+    }
+
+    char * sq = reinterpret_cast<char *>(_sq_map);
+    _sq_head = reinterpret_cast<unsigned int *>(sq + p.sq_off.head);
+    _sq_tail = reinterpret_cast<unsigned int *>(sq + p.sq_off.tail);
+    _sq_mask = reinterpret_cast<unsigned int *>(sq + p.sq_off.ring_mask);
+    _sq_array = reinterpret_cast<unsigned int *>(sq + p.sq_off.array);
+    _sq_entries = p.sq_entries;
+
+    char * cq = reinterpret_cast<char *>(_cq_map);
+    _cq_head = reinterpret_cast<unsigned int *>(cq + p.cq_off.head);
+    _cq_tail = reinterpret_cast<unsigned int *>(cq + p.cq_off.tail);
+    _cq_mask = reinterpret_cast<unsigned int *>(cq + p.cq_off.ring_mask);
+    _cqes = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+
+    _fd = fd;
+    return true;
+}
+
+bool Ring::supports(int fd, unsigned int opcode)
+{
+    // io_uring_probe termina com um vetor de tamanho variável: um por opcode possível (o campo é de 8 bits).
+    const unsigned int OPS = 256;
+    char buffer[sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op)];
+    memset(buffer, 0, sizeof(buffer));
+    io_uring_probe * probe = reinterpret_cast<io_uring_probe *>(buffer);
+
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, OPS) < 0)
+        return false;
+
+    return opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+}
+
+io_uring_sqe * Ring::sqe()
+{
+    unsigned int tail = *_sq_tail + _to_submit;
+    if (tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) >= _sq_entries)
+        return 0;
+
+    io_uring_sqe * e = &_sqes[tail & *_sq_mask];
+    memset(e, 0, sizeof(*e));
+    return e;
+}
+
+void Ring::push()
+{
+    unsigned int tail = *_sq_tail + _to_submit;
+    _sq_array[tail & *_sq_mask] = tail & *_sq_mask;
+    _to_submit++;
+}
+
+int Ring::submit()
+{
+    // Publica todas as entradas confirmadas de uma vez e as envia em uma única chamada, junto com as que
+    // o kernel recusou antes (io_uring_enter falhou): continuam entre a cabeça e a cauda da fila.
+    __atomic_store_n(_sq_tail, *_sq_tail + _to_submit, __ATOMIC_RELEASE);
+    _to_submit = 0;
+    unsigned int n = pending();
+    if (!n)
+        return 0;
+
+    int r = syscall(__NR_io_uring_enter, _fd, n, 0, 0, 0, 0);
+    db<IO>(TRC) << "Ring::submit(n=" << n << ") = " << r << "\n";
+    return r;
+}
+
+int Ring::register_eventfd(int fd)
+{
+    return syscall(__NR_io_uring_register, _fd, IORING_REGISTER_EVENTFD, &fd, 1);
+}
+
+__END_API
@@ -0,0 +1,137 @@
+#include "Concurrency/debug.h"
+#include "Concurrency/traits.h"
+
+#include "Concurrency/rwlock.h"
+
+__BEGIN_API
+
+void RWLock::read_lock()
+{
+    db<RWLock>(TRC) << "RWLock::read_lock called." << "\n";
+    __atomic_fetch_add(&_statistics.reads, 1, __ATOMIC_RELAXED);
+
+    Thread::int_disable();
+    Thread::lock();
+    if (!_writer && _waiting_writers.empty())
+    {
+        _readers++;
+        Thread::unlock();
+    }
+    else
+    {
+        // Acorda já contado em _readers (ver release()).
+        Thread::Microsecond since = Thread::now();
+        Thread::running()->sleep(&_waiting_readers);
+        account(_statistics.read_waits, _statistics.read_wait_time, since);
+    }
+    Thread::int_enable();
+}
+
+bool RWLock::try_read_lock()
+{
+    Thread::int_disable();
+    Thread::lock();
+    bool acquired = !_writer && _waiting_writers.empty();
+    if (acquired)
+        _readers++;
+    Thread::unlock();
+    Thread::int_enable();
+
+    if (acquired)
+        __atomic_fetch_add(&_statistics.reads, 1, __ATOMIC_RELAXED);
+
+    return acquired;
+}
+
+void RWLock::read_unlock()
+{
+    db<RWLock>(TRC) << "RWLock::read_unlock called." << "\n";
+    Thread::int_disable();
+    Thread::lock();
+    if (--_readers == 0)
+        release(false);
+    Thread::unlock();
+    Thread::int_enable();
+}
+
+void RWLock::write_lock()
+{
+    db<RWLock>(TRC) << "RWLock::write_lock called." << "\n";
+    __atomic_fetch_add(&_statistics.writes, 1, __ATOMIC_RELAXED);
+
+    Thread::int_disable();
+    Thread::lock();
+    if (!_writer && !_readers)
+    {
+        _writer = true;
+        Thread::unlock();
+    }
+    else
+    {
+        // Acorda já com _writer (ver release()).
+        Thread::Microsecond since = Thread::now();
+        Thread::running()->sleep(&_waiting_writers);
+        account(_statistics.write_waits, _statistics.write_wait_time, since);
+    }
+    Thread::int_enable();
+}
+
+bool RWLock::try_write_lock()
+{
+    Thread::int_disable();
+    Thread::lock();
+    bool acquired = !_writer && !_readers;
+    if (acquired)
+        _writer = true;
+    Thread::unlock();
+    Thread::int_enable();
+
+    if (acquired)
+        __atomic_fetch_add(&_statistics.writes, 1, __ATOMIC_RELAXED);
+
+    return acquired;
+}
+
+void RWLock::write_unlock()
+{
+    db<RWLock>(TRC) << "RWLock::write_unlock called." << "\n";
+    Thread::int_disable();
+    Thread::lock();
+    _writer = false;
+    release(true);
+    Thread::unlock();
+    Thread::int_enable();
+}
+
+void RWLock::release(bool writer)
+{
+    // Depois de um escritor, o lote de leitores que esperava; depois do último leitor (ou sem leitores
+    // esperando), o próximo escritor. Leitores só esperam se há um escritor ativo ou esperando.
+    if (writer && !_waiting_readers.empty())
+    {
+        while (!_waiting_readers.empty())
+        {
+            _readers++;
+            _waiting_readers.remove()->object()->wake();
+        }
+    }
+    else if (!_waiting_writers.empty())
+    {
+        _writer = true;
+        _waiting_writers.remove()->object()->wake();
+    }
+}
+
+void RWLock::account(unsigned long long & waits, Thread::Microsecond & time, const Thread::Microsecond & since)
+{
+    __atomic_fetch_add(&waits, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&time, Thread::now() - since, __ATOMIC_RELAXED);
+}
+
+RWLock::~RWLock()
+{
+    if (_writer || _readers || !_waiting_readers.empty() || !_waiting_writers.empty())
+        db<RWLock>(WRN) << "RWLock destruído em uso.\n";
+}
+
+__END_API
@@ -0,0 +1,165 @@
+#include "Concurrency/debug.h"
+#include "Concurrency/traits.h"
+
+#include "Concurrency/select.h"
+
+__BEGIN_API
+
+int Select::add(Kind kind, Channel_Common * channel, Attempt attempt, void * value, Semaphore * semaphore)
+{
+    if (_count == CASES)
+    {
+        db<Select>(WRN) << "Select: mais de " << _count << " casos.\n";
+        return NONE;
+    }
+
+    Case & c = _cases[_count];
+    c.kind = kind;
+    c.channel = channel;
+    c.attempt = attempt;
+    c.value = value;
+    c.semaphore = semaphore;
+    c.waiter.select = this;
+
+    return _count++;
+}
+
+int Select::wait(const Microsecond & timeout)
+{
+    db<Select>(TRC) << "Select::wait(timeout=" << timeout << ") called." << "\n";
+    Thread::int_disable();
+    Thread::lock();
+
+    _thread = Thread::running();
+    _fired = NONE;
+    _ok = false;
+
+    // Algum caso já pronto: não dorme.
+    for (int i = 0; i < _count; i++)
+        if (attempt(_cases[i]))
+        {
+            Thread::unlock();
+            Thread::int_enable();
+            return i;
+        }
+
+    if (timeout == 0)
+    {
+        Thread::unlock();
+        Thread::int_enable();
+        return NONE;
+    }
+
+    // Entra em todas as filas com a trava adquirida: nenhum caso fica pronto sem encontrar a thread nelas.
+    for (_enrolled = 0; _enrolled < _count; _enrolled++)
+        if (enroll(_cases[_enrolled]))
+        {
+            // O semáforo foi liberado entre attempt() e enroll().
+            int i = _enrolled;
+            _ok = true;
+            withdraw(i);
+            Thread::unlock();
+            Thread::int_enable();
+            return i;
+        }
+
+    _thread->_select = this;
+    _thread->sleep(0, timeout > 0 ? Thread::now() + timeout : 0);
+    Thread::int_enable();
+
+    // Acordada por fire() ou, sem _fired, pelo prazo (ver Thread::timeout()).
+    return _fired;
+}
+
+bool Select::attempt(Case & c)
+{
+    switch (c.kind)
+    {
+    case RECV:
+        // Um canal fechado ainda entrega os valores do buffer.
+        _ok = c.attempt(c.channel, c.value);
+        return _ok || c.channel->_closed;
+    case SEND:
+        _ok = !c.channel->_closed && c.attempt(c.channel, c.value);
+        return _ok || c.channel->_closed;
+    case P:
+        _ok = c.semaphore->try_p();
+        return _ok;
+    }
+    return false;
+}
+
+bool Select::enroll(Case & c)
+{
+    if (c.kind == P)
+    {
+        // Como em Semaphore::p(): o decremento registra a thread, que espera na fila se não obteve o semáforo.
+        Semaphore * s = c.semaphore;
+        if (s->fdec(s->_value) >= 1)
+            return true;
+        if (s->_wakeups > 0)
+        {
+            s->_wakeups--;
+            return true;
+        }
+        c.link = Thread::Asleep_Queue::Element(_thread, Thread::get_now_timestamp());
+        s->_asleep.insert(&c.link);
+        return false;
+    }
+
+    c.waiter.thread = _thread;
+    c.waiter.item = c.value;
+    c.waiter.link = Channel_Common::Waiter_Element(&c.waiter);
+    (c.kind == RECV ? c.channel->_receivers : c.channel->_senders).insert(&c.waiter.link);
+    return false;
+}
+
+void Select::withdraw(int except)
+{
+    for (int i = 0; i < _enrolled; i++)
+    {
+        if (i == except)
+            continue;
+
+        Case & c = _cases[i];
+        if (c.kind == P)
+        {
+            // Desfaz o decremento como um p() com prazo expirado; se um v() já contava com esta thread, o
+            // semáforo obtido é devolvido.
+            c.semaphore->_asleep.remove(&c.link);
+            if (c.semaphore->cancel())
+                c.semaphore->release();
+        }
+        else
+            (c.kind == RECV ? c.channel->_receivers : c.channel->_senders).remove(&c.waiter.link);
+    }
+
+    _enrolled = 0;
+    _thread->_select = 0;
+}
+
+void Select::fire(int i)
+{
+    db<Select>(TRC) << "Select::fire(i=" << i << ")\n";
+    _fired = i;
+    withdraw(i);
+    _thread->wake();
+}
+
+int Select::index(Channel_Common::Waiter * waiter)
+{
+    int i = 0;
+    while (&_cases[i].waiter != waiter)
+        i++;
+    return i;
+}
+
+int Select::index(Thread::Asleep_Queue::Element * link)
+{
+    int i = 0;
+    while (&_cases[i].link != link)
+        i++;
+    return i;
+}
+
+__END_API
@@ -3,6 +3,7 @@
 #include "Concurrency/traits.h"
 
 #include "Concurrency/semaphore.h"
+#include "Concurrency/select.h"
 
 __BEGIN_API
 
@@ -15,27 +16,143 @@ void Semaphore::p()
     // dormir caso a mesma nao conseguir acessar o semaforo (ja existir em uso por outra Thread).
 
     db<Semaphore>(TRC) << "Semaphore::p called." << "\n";
+    Thread::trace(Trace::P, (long)this);
+    if (SPIN && _value <= 0)
+        spin();
+
+    // Sem disputa, o fdec basta.
+    if (fdec(_value) >= 1)
+        return;
+
     // PRECISA GARANTIR ATOMICIDADE.
-    if(fdec(_value) < 1)
+    // Com mais de um worker, a trava do escalonador ordena a inserção em _asleep e o v() que procura a thread.
+    Thread::int_disable();
+    Thread::lock();
+    if (_wakeups > 0)
+    {
+        // O v() chegou antes: o semáforo já é desta thread.
+        _wakeups--;
+        Thread::unlock();
+    }
+    else
     {
         sleep();
     }
+    Thread::int_enable();
 
 }
 
-void Semaphore::v()
+bool Semaphore::p(const Thread::Microsecond & timeout)
+{
+    db<Semaphore>(TRC) << "Semaphore::p(timeout=" << timeout << ") called." << "\n";
+    Thread::trace(Trace::P, (long)this);
+    if (SPIN && _value <= 0)
+        spin();
+
+    if (fdec(_value) >= 1)
+        return true;
+
+    bool acquired = true;
+    Thread::int_disable();
+    Thread::lock();
+    if (_wakeups > 0)
+    {
+        _wakeups--;
+        Thread::unlock();
+    }
+    else if (timeout <= 0)
+    {
+        // Prazo já vencido: desiste sem dormir.
+        acquired = cancel();
+        Thread::unlock();
+    }
+    else if (!sleep(Thread::now() + timeout))
+    {
+        Thread::lock();
+        acquired = cancel();
+        Thread::unlock();
+    }
+    Thread::int_enable();
+
+    return acquired;
+}
+
+bool Semaphore::try_p()
+{
+    db<Semaphore>(TRC) << "Semaphore::try_p called." << "\n";
+    for (int value = _value; value > 0; )
+    {
+        int old = CPU::cas(_value, value, value - 1);
+        if (old == value)
+            return true;
+        value = old;
+    }
+    return false;
+}
+
+void Semaphore::v(bool reschedule)
 {
     // Este metodo deve implementar a operacao v (ou wakeup) de um semaforo. Deve-se
     // incrementar o inteiro do semaforo de forma atomica (utilizando finc descrita abaixo) e acordar
     // uma Thread que estiver dormindo no semaforo.
 
     db<Semaphore>(TRC) << "Semaphore::v called" << "\n";
+    Thread::trace(Trace::V, (long)this);
+    // Ninguém esperando: o finc basta.
+    if (finc(_value) >= 0)
+        return;
+
     // PRECISA GARANTIR ATOMICIDADE.
-    if(finc(_value) < 0)
+    Thread::int_disable();
+    Thread::lock();
+    wakeup(reschedule);
+    Thread::int_enable();
+
+}
+
+void Semaphore::spin()
+{
+    // Como o mutex adaptativo da glibc: espera por até o dobro da média recente (mais uma folga),
+    // limitado por spin_max. Uma espera que termina com o semáforo livre entra na média; uma que se esgota
+    // (seção crítica longa, ou dono fora do processador) a reduz, até a thread passar a dormir direto.
+    int max = _spins * 2 + 10;
+    if (max > Traits<Semaphore>::spin_max)
+        max = Traits<Semaphore>::spin_max;
+
+    int n = 0;
+    while (_value <= 0 && n < max)
     {
-        wakeup();
+        CPU::pause();
+        n++;
     }
 
+    if (n < max)
+        _spins += (n - _spins) / 8;
+    else
+        _spins -= _spins / 4 + 1;
+    if (_spins < 0)
+        _spins = 0;
+}
+
+bool Semaphore::cancel()
+{
+    // Um v() que contou com esta thread já passou por aqui: fica com o semáforo.
+    if (_wakeups > 0)
+    {
+        _wakeups--;
+        return true;
+    }
+
+    // Um v() que contou com esta thread ainda vai adquirir a trava: fica com o semáforo e deixa _wakeups
+    // negativo, para que esse v() não acorde outra thread (ver wakeup()).
+    if (finc(_value) >= 0)
+    {
+        fdec(_value);
+        _wakeups--;
+        return true;
+    }
+
+    return false;
 }
 
 int Semaphore::finc(volatile int & number)
@@ -52,34 +169,89 @@ int Semaphore::fdec(volatile int & number)
     return CPU::fdec(number);
 }
 
-void Semaphore::sleep()
+bool Semaphore::sleep(const Thread::Microsecond & deadline)
 {
     // O metodo sleep() deve colocar a Thread que nao conseguir acessar o semaforo para dormir e
     // mudar seu estado para WAITING (note que WAITING eh diferente de SUSPENDED do trabalho anterior).
-    // A Thread deve ser colocada na fila de dormindo do semaforo.
-    db<Semaphore>(TRC) << "Semaphore::sleep called to Thread "<< Thread::_running->id() << "\n";
-    _asleep.insert(&Thread::_running->_link);
-    Thread::_running->sleep(&_asleep);
+    // A Thread deve ser colocada na fila de dormindo do semaforo (feito por Thread::sleep).
+    // Chamado com Thread::lock() adquirido; a trava é liberada pelo despachante.
+    // Se o prazo expirar, quem chamou desfaz o decremento feito em p() (ver cancel()).
+    db<Semaphore>(TRC) << "Semaphore::sleep called to Thread "<< Thread::running()->id() << "\n";
+    return Thread::running()->sleep(&_asleep, deadline);
 }
 
 void Semaphore::wakeup(bool reschedule)
 {
+    // Chamado com Thread::lock() adquirido; retorna com a trava liberada.
+    // Uma desistência (cancel()) já ficou com o semáforo deste v(): ninguém mais é acordado.
+    if (_wakeups < 0)
+    {
+        _wakeups++;
+        Thread::unlock();
+        return;
+    }
 
     if (!_asleep.empty())
     {
-        Thread* thread_to_wakeup = _asleep.remove()->object();
+        Asleep_Queue::Element * link = _asleep.remove();
+        Select * select = Select::of(link);
+        if (select)
+        {
+            // Caso de um Select: recebe o semáforo, mas sem passagem de bastão.
+            select->fire(link);
+            Thread::unlock();
+            return;
+        }
+        Thread* thread_to_wakeup = link->object();
         thread_to_wakeup->wakeup(reschedule);
     }
+    else
+    {
+        // A thread que decrementou _value ainda não dormiu (ver p()).
+        _wakeups++;
+        Thread::unlock();
+    }
 }
 
 void Semaphore::wakeup_all()
 {
     // O metodo wakeup_all() deve acordar todas as Thread que estavam dormindo no semaforo.
     db<Semaphore>(TRC) << "Semaphore::wakeup_all called" << "\n";
+    // Todas de uma vez, sem ceder o processador entre uma e outra (ver Condition::broadcast()).
+    Thread::int_disable();
+    Thread::lock();
     while (!_asleep.empty())
     {
-        wakeup();
+        Asleep_Queue::Element * link = _asleep.remove();
+        Select * select = Select::of(link);
+        if (select)
+            select->fire(link);
+        else
+            link->object()->wake();
+    }
+    Thread::unlock();
+    Thread::int_enable();
+}
+
+void Semaphore::release()
+{
+    if (finc(_value) >= 0)
+        return;
+
+    // Como em wakeup().
+    if (_wakeups < 0)
+        _wakeups++;
+    else if (!_asleep.empty())
+    {
+        Asleep_Queue::Element * link = _asleep.remove();
+        Select * select = Select::of(link);
+        if (select)
+            select->fire(link);
+        else
+            link->object()->wake();
     }
+    else
+        _wakeups++;
 }
 
 Semaphore::~Semaphore()
@@ -0,0 +1,188 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include <new>
+
+#include "Concurrency/stack_pool.h"
+#include "Concurrency/spin.h"
+
+__BEGIN_API
+
+Stack_Pool::Bucket Stack_Pool::_buckets[Stack_Pool::BUCKETS];
+
+Spin Stack_Pool::_lock;
+
+void Stack_Pool::lock()
+{
+    if (Traits<Thread>::workers > 1)
+        _lock.acquire();
+}
+
+void Stack_Pool::unlock()
+{
+    if (Traits<Thread>::workers > 1)
+        _lock.release();
+}
+
+unsigned long Stack_Pool::page_size()
+{
+    static unsigned long size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+unsigned long Stack_Pool::round(unsigned int size)
+{
+    unsigned long page = page_size();
+    return (size + page - 1) & ~(page - 1);
+}
+
+Stack_Pool::Bucket * Stack_Pool::bucket(unsigned long size)
+{
+    // Poucos tamanhos distintos são usados em um processo, então uma busca linear basta.
+    for (unsigned int i = 0; i < BUCKETS; i++)
+    {
+        if (_buckets[i].size == size)
+            return &_buckets[i];
+        if (!_buckets[i].size)
+        {
+            _buckets[i].size = size;
+            return &_buckets[i];
+        }
+    }
+
+    return 0;
+}
+
+char * Stack_Pool::alloc(unsigned int size)
+{
+    unsigned long rounded = round(size);
+
+    lock();
+    Bucket * b = bucket(rounded);
+    if (b && b->free)
+    {
+        char * stack = b->free;
+        b->free = *(char **)stack;
+        b->cached--;
+        unlock();
+        return stack;
+    }
+    unlock();
+
+    return map(rounded);
+}
+
+void Stack_Pool::free(char * stack, unsigned int size)
+{
+    unsigned long rounded = round(size);
+
+    lock();
+    Bucket * b = bucket(rounded);
+    if (!b || b->cached >= Traits<Stack_Pool>::max_cached)
+    {
+        unlock();
+        unmap(stack, rounded);
+        return;
+    }
+    unlock();
+
+    // A pilha continua reservada para reuso, mas suas páginas voltam para o SO.
+    if (LAZY)
+        discard(stack, stack + rounded);
+
+    lock();
+    *(char **)stack = b->free;
+    b->free = stack;
+    b->cached++;
+    unlock();
+}
+
+unsigned int Stack_Pool::cached(unsigned int size)
+{
+    lock();
+    Bucket * b = bucket(round(size));
+    unsigned int n = b ? b->cached : 0;
+    unlock();
+
+    return n;
+}
+
+void Stack_Pool::trim(char * stack, void * sp)
+{
+    // A página que contém sp ainda está em uso; tudo abaixo dela não.
+    char * end = (char *)((unsigned long)sp & ~(page_size() - 1));
+    if (end > stack)
+        discard(stack, end);
+}
+
+void Stack_Pool::paint(char * stack, unsigned int size)
+{
+    unsigned long * word = (unsigned long *)stack;
+    unsigned long * end = (unsigned long *)(stack + size);
+    while (word < end)
+        *word++ = CANARY;
+}
+
+unsigned int Stack_Pool::usage(char * stack, unsigned int size)
+{
+    // A pilha cresce para baixo: o primeiro valor diferente do canário, a partir do início, marca o pico.
+    unsigned long * word = (unsigned long *)stack;
+    unsigned long * end = (unsigned long *)(stack + size);
+    while (word < end && *word == CANARY)
+        word++;
+
+    return (char *)end - (char *)word;
+}
+
+void Stack_Pool::discard(char * begin, char * end)
+{
+    db<Stack_Pool>(TRC) << "Stack_Pool::discard(b=" << (void *)begin << ",e=" << (void *)end << ")\n";
+#ifdef MADV_FREE
+    madvise(begin, end - begin, Traits<Stack_Pool>::madv_free ? MADV_FREE : MADV_DONTNEED);
+#else
+    madvise(begin, end - begin, MADV_DONTNEED);
+#endif
+}
+
+void Stack_Pool::prewarm(unsigned int n)
+{
+    db<Stack_Pool>(TRC) << "Stack_Pool::prewarm(n=" << n << ")\n";
+    while (cached() < n)
+        free(map(round(STACK_SIZE)));
+}
+
+char * Stack_Pool::map(unsigned long size)
+{
+    // A pilha cresce para baixo, então a página de guarda fica no início da região mapeada.
+    unsigned long guard = page_size();
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK;
+    if (LAZY)
+        flags |= MAP_NORESERVE; // apenas reserva o espaço de endereçamento.
+
+    void * region = mmap(0, guard + size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (region == MAP_FAILED)
+    {
+        db<Stack_Pool>(ERR) << "Stack_Pool::map: mmap falhou.\n";
+        throw std::bad_alloc();
+    }
+
+    if (mprotect(region, guard, PROT_NONE) != 0)
+    {
+        db<Stack_Pool>(ERR) << "Stack_Pool::map: mprotect falhou.\n";
+        munmap(region, guard + size);
+        throw std::bad_alloc();
+    }
+
+    db<Stack_Pool>(TRC) << "Stack_Pool::map(s=" << size << ") => " << (void *)((char *)region + guard) << "\n";
+
+    return (char *)region + guard;
+}
+
+void Stack_Pool::unmap(char * stack, unsigned long size)
+{
+    unsigned long guard = page_size();
+
+    munmap(stack - guard, guard + size);
+}
+
+__END_API
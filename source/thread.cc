@@ -3,8 +3,16 @@
 #include <queue>
 #include <chrono>
 #include <ctime>
+#include <sched.h>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include "Concurrency/thread.h"
+#include "Concurrency/io.h"
+#include "Concurrency/helper_pool.h"
+#include "Concurrency/select.h"
 
 __BEGIN_API
 
@@ -17,44 +25,159 @@ int Thread::_numOfThreads = 0;
 
 queue<int> Thread::_released_ids;
 
-Thread *Thread::_running;
+Thread::Thread_Queue Thread::_threads; // antes da main e dos despachantes, que se retiram dela ao serem destruídos.
 
 Thread Thread::_main;
 
-CPU::Context Thread::_main_context;
+Thread Thread::_dispatchers[Thread::WORKERS];
 
-Thread Thread::_dispatcher;
+Thread::Worker Thread::_workers[Thread::WORKERS];
+
+thread_local Thread::Worker * Thread::_worker;
+
+Spin Thread::_lock;
+
+int Thread::_runnable = 0;
+
+volatile bool Thread::_stopping = false;
+
+volatile int Thread::_parked = 0;
+
+volatile int Thread::_unparks = 0;
 
 Thread::Ready_Queue Thread::_ready;
 
-Thread::Ready_Queue Thread::_suspended;
+Thread::Thread_Queue Thread::_suspended;
+
+Thread::Thread_Queue Thread::_finished;
+
+Thread::Thread_Queue Thread::_idle;
+
+Thread::Timer_Wheel Thread::_timers;
 
 void Thread::init(void (*main)(void *))
 {
+    // Mapeia antecipadamente as pilhas das primeiras threads.
+    Stack_Pool::prewarm(Traits<Stack_Pool>::prewarm);
+
+    if (Trace::ENABLED || STATS)
+        Trace::init();
+
+    // A thread do kernel que chamou init é o worker 0.
+    for (unsigned int i = 0; i < WORKERS; i++)
+    {
+        _workers[i].id = i;
+        _workers[i].seed = 2463534242u + i * 2654435761u; // semente do xorshift, nunca zero.
+        _workers[i].disabled = 1; // até a primeira thread começar a executar.
+    }
+    _worker = &_workers[0];
+
+    if (PREEMPTIVE)
+    {
+        struct sigaction action = {};
+        action.sa_sigaction = &timer_handler;
+        action.sa_flags = SA_SIGINFO | SA_RESTART | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGALRM, &action, 0);
+        start_timer(&_workers[0]);
+    }
+
     // Cria a thread main, passando main() e a string "Main" como parâmetros.
     // A string é argumento da função main().
     create_main_thread(main);
 
-    // Cria a thread dispatcher, que será responsável por escolher a próxima thread a ser executada.
+    // Cria as threads dispatcher, que serão responsáveis por escolher a próxima thread a ser executada.
     create_dispatcher_thread();
 
-    // Pega o contexto da main() do main.cc e salva em _main_context.
-    new (&_main_context) CPU::Context();
+    // Inicia os demais workers, que ficam aguardando threads prontas.
+    start_workers();
 
-    // Troca o contexto da main() do main.cc para o contexto da Thread::_main criada aqui.
-    CPU::switch_context(&_main_context, _main.context());
+    // Troca o contexto da main() do main.cc (salvo em _workers[0].native) para o contexto da Thread::_main criada aqui.
+    CPU::switch_context(&_workers[0].native, _main.context());
 }
 
 void Thread::create_main_thread(void (*main)(void *))
 {
-    new (&_main) Thread(main, (void *)"Main");
-    _running = &_main;
+    ::new (&_main) Thread(main, (void *)"Main");
+    _workers[0].running = &_main;
     _main._state = RUNNING;
+    if (STATS_TIME)
+        _main.account(RUNNING, Trace::tsc());
+    _runnable++; // a main já começa executando no worker 0.
 }
 
 void Thread::create_dispatcher_thread()
 {
-    new (&_dispatcher) Thread(&dispatcher);
+    for (unsigned int i = 0; i < WORKERS; i++)
+    {
+        ::new (&_dispatchers[i]) Thread(&dispatcher);
+        _workers[i].dispatcher = &_dispatchers[i];
+    }
+}
+
+void Thread::start_workers()
+{
+    for (unsigned int i = 1; i < WORKERS; i++)
+        pthread_create(&_workers[i].kernel, 0, &run_worker, &_workers[i]);
+}
+
+void * Thread::run_worker(void * worker)
+{
+    Worker * w = reinterpret_cast<Worker *>(worker);
+    _worker = w;
+
+    db<Thread>(TRC) << "WORKER " << w->id << " INICIADO.\n";
+
+    // Executa o despachante deste worker até que todas as threads terminem.
+    // Não há troca pendente a ser concluída na primeira entrada no despachante.
+    w->prev = 0;
+    w->running = w->dispatcher;
+    if (PREEMPTIVE)
+        start_timer(w);
+    CPU::switch_context(&w->native, w->dispatcher->context());
+
+    return 0;
+}
+
+// Funções que leem o worker atual e o usam em seguida. Se a thread fosse preemptada entre a leitura e o uso,
+// poderia voltar a executar em outro worker e usar o anterior: o tratador do temporizador adia a preempção
+// quando interrompe código desta seção.
+#define NO_PREEMPTION __attribute__((section("thread_nopreempt"), noinline, noclone))
+
+extern "C" char __start_thread_nopreempt[];
+extern "C" char __stop_thread_nopreempt[];
+
+NO_PREEMPTION Thread * Thread::current_running()
+{
+    return current_worker()->running;
+}
+
+NO_PREEMPTION void Thread::disable()
+{
+    worker()->disabled++;
+    asm volatile("" ::: "memory");
+}
+
+NO_PREEMPTION void Thread::enable()
+{
+    asm volatile("" ::: "memory");
+    Worker * w = worker();
+    if (--w->disabled == 0 && w->pending)
+        preempt();
+}
+
+NO_PREEMPTION Thread::Worker * Thread::current_worker()
+{
+    // O compilador não pode reaproveitar o endereço da variável TLS entre chamadas: depois de uma troca de
+    // contexto, a mesma thread pode estar executando em outro worker.
+    Worker * w = _worker;
+    asm volatile("" : "+r"(w));
+    return w;
+}
+
+bool Thread::is_dispatcher()
+{
+    return this >= &_dispatchers[0] && this < &_dispatchers[WORKERS];
 }
 
 int Thread::id()
@@ -62,6 +185,134 @@ int Thread::id()
     return this->_id;
 }
 
+unsigned int Thread::stack_size()
+{
+    return this->_context ? this->_context->stack_size() : 0;
+}
+
+unsigned int Thread::stack_usage()
+{
+    return this->_context ? this->_context->stack_usage() : 0;
+}
+
+void Thread::switched(Worker * w, Thread * prev, Thread * next)
+{
+    unsigned long long now = STATS_TIME ? Trace::tsc() : 0;
+
+    // prev ainda em RUNNING volta para a fila de prontos (yield, preempção, handoff); senão já está no novo estado.
+    State state = prev->_state;
+    prev->account(state == RUNNING ? READY : state, now);
+    if (w->preempted)
+    {
+        prev->_statistics.involuntary++;
+        w->preempted = false;
+    }
+    else
+        prev->_statistics.voluntary++;
+
+    next->account(RUNNING, now);
+    next->_statistics.dispatches++;
+    w->switches++;
+}
+
+Thread::Statistics Thread::statistics(unsigned long long now, double per_ns)
+{
+    // Lido sem a trava: uma troca em andamento em outro worker pode deixar o período atual de fora.
+    Statistics s = _statistics;
+    unsigned long long since = _since;
+    if (STATS_TIME && now > since)
+        s.time[_phase] += now - since;
+    for (unsigned int i = 0; i < STATES; i++)
+        s.time[i] = (unsigned long long)(s.time[i] / per_ns);
+    s.id = _id;
+    s.state = _state;
+    return s;
+}
+
+Thread::Statistics Thread::statistics()
+{
+    return statistics(Trace::tsc(), Trace::ticks_per_us() / 1000);
+}
+
+Thread::Snapshot Thread::stats()
+{
+    Snapshot s = Snapshot();
+    double per_ns = Trace::ticks_per_us() / 1000;
+
+    int_disable();
+    lock();
+    // A trava não pode esperar por uma alocação: o vetor é reservado sem ela, com o tamanho de _threads (que
+    // inclui as threads já terminadas e ainda não destruídas), e de novo se a lista cresceu nesse meio tempo.
+    for (unsigned int n; (n = _threads.size()) > s.threads.capacity(); )
+    {
+        unlock();
+        s.threads.reserve(n + 16);
+        lock();
+    }
+    unsigned long long now = Trace::tsc();
+    s.uptime = (unsigned long long)((now - Trace::origin()) / per_ns);
+    for (unsigned int i = 0; i < WORKERS; i++)
+    {
+        s.switches += _workers[i].switches;
+        s.dispatched += _workers[i].dispatched;
+        s.preemptions += _workers[i].preemptions;
+        s.steals += _workers[i].steals;
+    }
+    for (Thread_Queue::Element * e = _threads.head(); e; e = e->next())
+    {
+        Thread * t = e->object();
+        if (t->is_dispatcher())
+            s.dispatcher_time += t->statistics(now, per_ns).time[RUNNING];
+        else
+            s.threads.push_back(t->statistics(now, per_ns));
+    }
+    unlock();
+    int_enable();
+
+    return s;
+}
+
+void Thread::top(FILE * out, unsigned int lines)
+{
+    static const char * states[STATES] = { "RUNNING", "READY", "SUSPEND", "FINISHING", "WAITING" };
+    // Chamada anterior, para as taxas (como o intervalo de atualização do top).
+    static unsigned long long last_uptime = 0;
+    static unsigned long long last_switches = 0;
+
+    // O retrato é alocado, ordenado e destruído (malloc/free) dentro da seção, como a escrita.
+    int_disable();
+    {
+        Snapshot s = stats();
+        unsigned int n = std::min((unsigned int)s.threads.size(), lines);
+        std::partial_sort(s.threads.begin(), s.threads.begin() + n, s.threads.end(),
+                          [](const Statistics & a, const Statistics & b) {
+                              // Sem stats_time, os tempos são zero: as que mais receberam o processador.
+                              return STATS_TIME ? a.time[RUNNING] > b.time[RUNNING] : a.dispatches > b.dispatches;
+                          });
+
+        double interval = (s.uptime - last_uptime) / 1e9;
+        double rate = interval > 0 ? (s.switches - last_switches) / interval : 0;
+        last_uptime = s.uptime;
+        last_switches = s.switches;
+
+        fprintf(out, "ATIVO %.3f s, %u THREADS, %u WORKERS, DESPACHANTES %.1f%%\n", s.uptime / 1e9,
+                (unsigned int)s.threads.size(), WORKERS, s.uptime ? 100.0 * s.dispatcher_time / s.uptime / WORKERS : 0.0);
+        fprintf(out, "TROCAS %llu (%.0f/s), PELO DESPACHANTE %llu, PREEMPÇÕES %llu, ROUBOS %llu\n",
+                s.switches, rate, s.dispatched, s.preemptions, s.steals);
+        fprintf(out, "%6s %-9s %12s %12s %12s %12s %10s %10s %10s\n",
+                "ID", "ESTADO", "EXEC(ms)", "PRONTA(ms)", "ESPERA(ms)", "SUSP(ms)", "DESPACHOS", "VOLUNT", "INVOLUNT");
+        for (unsigned int i = 0; i < n; i++)
+        {
+            const Statistics & t = s.threads[i];
+            fprintf(out, "%6d %-9s %12.3f %12.3f %12.3f %12.3f %10llu %10llu %10llu\n",
+                    t.id, states[t.state], t.time[RUNNING] / 1e6, t.time[READY] / 1e6, t.time[WAITING] / 1e6,
+                    t.time[SUSPEND] / 1e6, t.dispatches, t.voluntary, t.involuntary);
+        }
+        fflush(out);
+    }
+    int_enable();
+}
+
 int Thread::get_now_timestamp()
 {
     return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
@@ -69,52 +320,369 @@ int Thread::get_now_timestamp()
 
 int Thread::get_available_id()
 {
+    // _available_id é sempre o maior id já usado: um id reaproveitado não pode fazer a contagem recomeçar dele,
+    // senão as próximas threads recebem ids de threads ainda vivas.
     if (Thread::_released_ids.empty())
-        Thread::_available_id++;
-    else
-    {
-        Thread::_available_id = Thread::_released_ids.front();
-        Thread::_released_ids.pop();
-    }
+        return ++Thread::_available_id;
 
-    return Thread::_available_id;
+    int id = Thread::_released_ids.front();
+    Thread::_released_ids.pop();
+    return id;
 } // retorna o id da thread, que é um atributo privado.
 
 void Thread::dispatcher()
 {
-    while (!_ready.empty())
+    Worker * w = worker(); // o despachante nunca muda de worker.
+    w->disabled = 1; // o despachante nunca é preemptado.
+
+    for (;;)
     {
+        check_events(false);
+
         // Escolhe a próxima thread a ser executada.
-        // E já a prepara, setando seu estado e o ponteiro _running.
+        // E já a prepara, setando seu estado e o ponteiro running do worker.
         Thread* nextThreadToRun = get_thread_to_dispatch_ready();
 
-        // Torna o dispatcher a thread que está executando no momento.
-        prepare_dispatcher_to_run_again();
+        if (nextThreadToRun)
+            w->idle = 0;
+        else
+        {
+            if (_stopping)
+                break;
+
+            // Fim de uma passada: as submissões de E/S das threads que dormiram vão juntas para o kernel.
+            IO::flush();
+
+            // Sem threads prontas ou executando em algum worker: todas terminaram ou estão bloqueadas.
+            // Se alguma espera um prazo ou um descritor, bloqueia o worker no kernel até o próximo evento.
+            if (!_runnable)
+            {
+                lock();
+                expire_timers();
+                if (_runnable)
+                {
+                    unlock();
+                    continue;
+                }
+                if (_timers.empty() && !IO::waiting())
+                {
+                    _stopping = true;
+                    unlock();
+                    IO::interrupt();
+                    unpark(true);
+                    continue;
+                }
+                Microsecond next = _timers.empty() ? 0 : _timers.next();
+                unlock();
+
+                // Com threads esperando descritores, o epoll_wait também serve de espera pelo temporizador.
+                if (IO::waiting())
+                {
+                    Microsecond timeout = -1;
+                    if (next)
+                    {
+                        timeout = next - now();
+                        if (timeout < 0)
+                            timeout = 0;
+                    }
+                    IO::react(timeout);
+                }
+                else
+                {
+                    struct timespec ts = { (time_t)(next / 1000000), (long)(next % 1000000) * 1000 };
+                    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0);
+                }
+                continue;
+            }
+
+            // Outro worker ainda pode tornar threads prontas.
+            idle(w);
+            continue;
+        }
 
         db<Thread>(TRC) << "THREAD" << nextThreadToRun->_id << "EM EXECUÇÂo" << "\n";
-        db<Thread>(TRC) << "READY QUEUE: " << _ready.size() << "\n";
 
         // Troca o contexto para a próxima thread a ser executada.
         // Ou seja, a partir daqui, a próxima thread a ser executada é a que acabou de ser escolhida.
-        // Assim, a próxima linha após a troca de contexto só será executada quando a thread escolhida terminar sua execução
-        // e o despachante voltar a ser executado.
-        Thread::switch_context(&_dispatcher, nextThreadToRun);
+        // Assim, a próxima linha após a troca de contexto só será executada quando a thread escolhida devolver
+        // o processador ao despachante, que então conclui a troca (reinserção na fila e liberação da trava).
+        if (Trace::ENABLED)
+            Trace::record(w->id, Trace::SWITCH, w->dispatcher->_id, nextThreadToRun->_id);
+        if (STATS)
+        {
+            switched(w, w->dispatcher, nextThreadToRun);
+            w->dispatched++;
+        }
+        Thread::switch_context(w->dispatcher, nextThreadToRun);
+
+        complete_switch(w);
+        w->disabled = 1;
 
         // Ao voltar ao despachante, verifica se a próxima thread a ser executada (que está no começo da fila)
         // terminou sua execução. Se sim, a removerá da fila de prontos.
-        check_if_next_thread_is_finished();
+        if (!SMP)
+            check_if_next_thread_is_finished();
+    }
+
+    if (PREEMPTIVE)
+    {
+        timer_delete(w->timer);
+        w->pending = false; // não há mais para quem trocar.
+    }
+
+    // Caso não haja mais threads, acabaram a execução todas as threads.
+    // Assim, o despachante do worker 0 retorna para a thread main; os demais encerram sua thread do kernel.
+    if (w->id == 0)
+        return_to_main();
+
+    w->dispatcher->_state = FINISHING;
+    CPU::switch_context(w->dispatcher->context(), &w->native);
+}
+
+void Thread::complete_switch(Worker * w)
+{
+    Thread * prev = w->prev;
+    if (!prev)
+        return;
+    w->prev = 0;
+
+    // Executado pela thread que recebeu o processador (o despachante ou outra thread, na troca direta).
+    // O contexto de prev já foi salvo: a partir daqui ela pode ser despachada por qualquer worker.
+    if (w->requeue)
+    {
+        // Atualiza a prioridade da tarefa que estava sendo executada com o timestamp atual.
+        prev->_link.rank(get_now_timestamp());
+
+        if (SMP && !w->locked && prev->claim(RUNNING, READY))
+            insert_thread_link_on_ready_queue(prev);
+        else
+        {
+            // Suspensa por outro worker enquanto executava (ver suspend()), ou sem SMP.
+            if (!w->locked)
+                lock();
+
+            if (prev->_state == SUSPEND)
+            {
+                // Suspensa por outro worker depois que sua troca foi contabilizada.
+                if (STATS_TIME)
+                    prev->account(SUSPEND, Trace::tsc());
+                _suspended.insert(&prev->_link);
+                prev->mark_idle();
+            }
+            else
+            {
+                prev->_state = READY;
+                insert_thread_link_on_ready_queue(prev);
+            }
+
+            if (!w->locked)
+                unlock();
+        }
+
+        db<Thread>(TRC) << "\nTHREAD " << prev->_id << " REINSERIDA NA FILA DE PRONTAS.\n";
+    }
+
+    if (w->locked)
+    {
+        release_finished_threads();
+
+        // Com pilhas preguiçosas, devolve ao SO as páginas das threads ociosas há muito tempo.
+        if (Stack_Pool::LAZY)
+            trim_idle_stacks();
+
+        // Os prazos são verificados a cada troca, depois que prev saiu do processador: assim uma thread
+        // que acabou de dormir nunca é acordada pelo próprio prazo enquanto ainda executa.
+        expire_timers();
+        unlock();
+    }
+    else
+        check_events(false);
+}
+
+Thread * Thread::steal(Worker * w)
+{
+    Thread * t;
+
+    // Primeiro a própria fila, na ordem de inserção, para manter a justiça do yield.
+    while (w->ready.steal(t))
+        if (take(t))
+            return t;
+
+    // Depois a de uma vítima aleatória, seguindo pelas demais.
+    unsigned int s = w->seed;
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    w->seed = s;
+
+    for (unsigned int i = 0; i < WORKERS; i++)
+    {
+        Worker * victim = &_workers[(s + i) % WORKERS];
+        if (victim == w)
+            continue;
+
+        while (victim->ready.steal(t))
+            if (take(t))
+            {
+                if (STATS)
+                    w->steals++;
+                return t;
+            }
+    }
+
+    return 0;
+}
+
+bool Thread::take(Thread * t)
+{
+    // Referências obsoletas (a thread foi suspensa, adormecida ou já despachada por outra referência) são descartadas.
+    bool taken = t->claim(READY, RUNNING);
+    __sync_fetch_and_sub(&t->_entries, 1);
+    return taken;
+}
+
+bool Thread::remove_from_ready(State to)
+{
+    if (SMP)
+        return claim(READY, to); // a referência na fila do worker fica obsoleta e é descartada ao ser retirada.
+
+    _state = to;
+    _ready.remove(&_link);
+    return true;
+}
+
+void Thread::drop_entries()
+{
+    // Percorre as filas de todos os workers uma vez, devolvendo à fila do worker atual as demais threads.
+    Worker * w = worker();
+    for (unsigned int i = 0; i < WORKERS; i++)
+    {
+        Ready_Deque & ready = _workers[i].ready;
+        Thread * t;
+        for (long n = ready.size(); n > 0 && ready.steal(t); n--)
+        {
+            if (t == this)
+                __sync_fetch_and_sub(&_entries, 1);
+            else
+                w->ready.push(t);
+        }
+    }
+
+    // As restantes estão sendo retiradas por outros workers.
+    while (_entries)
+        CPU::pause();
+}
+
+void Thread::idle(Worker * w)
+{
+    // Uma thread que fica pronta logo em seguida é roubada sem chamada de sistema.
+    if (!SMP || w->idle < Traits<Thread>::idle_spins)
+    {
+        w->idle++;
+        for (int i = 0; i < 64 && !_stopping; i++)
+            CPU::pause();
+        sched_yield();
+        return;
+    }
+
+    // Sem threads prontas há algum tempo (ex.: uma única thread longa em outro worker): dorme no kernel em vez
+    // de ocupar um processador. Só volta a esperar ocupado se outro worker o acordou com uma thread pronta.
+    if (park())
+        w->idle = 0;
+}
+
+bool Thread::park()
+{
+    int unparks = __atomic_load_n(&_unparks, __ATOMIC_ACQUIRE);
+    __atomic_add_fetch(&_parked, 1, __ATOMIC_SEQ_CST);
+
+    // Confere de novo depois de se anunciar (pareado com ready_pushed()). Sem threads prontas ou executando,
+    // o despachante não dorme aqui: é ele quem espera pelo próximo prazo ou descritor (ver dispatcher()).
+    bool ready = false;
+    for (unsigned int i = 0; i < WORKERS && !ready; i++)
+        ready = _workers[i].ready.size() > 0;
+
+    if (!ready && !_stopping && _runnable)
+    {
+        // No máximo um tick: enquanto os demais workers executam sem trocar de contexto, só os despachantes
+        // ociosos expiram os prazos e consultam os descritores (check_events()).
+        struct timespec timeout = { (time_t)(Traits<Thread>::tick / 1000000), (long)(Traits<Thread>::tick % 1000000) * 1000 };
+        syscall(SYS_futex, &_unparks, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, unparks, &timeout, 0, 0);
     }
 
-    // Caso a fila esteja vazia, acabaram a execução todas as threads.
-    // Assim, o despachante retorna para a thread main.
-    return_to_main();
+    __atomic_sub_fetch(&_parked, 1, __ATOMIC_RELAXED);
+    return __atomic_load_n(&_unparks, __ATOMIC_RELAXED) != unparks;
+}
+
+void Thread::unpark(bool all)
+{
+    __atomic_add_fetch(&_unparks, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &_unparks, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, all ? WORKERS : 1, 0, 0, 0);
 }
 
 void Thread::return_to_main()
 {
     db<Thread>(TRC) << "THREAD MAIN EM EXECUÇÃO" << "\n";
-    _dispatcher._state = FINISHING;
-    switch_context(&_dispatcher, &_main);
+
+    // Aguarda os demais workers encerrarem antes de voltar para a main.
+    for (unsigned int i = 1; i < WORKERS; i++)
+        pthread_join(_workers[i].kernel, 0);
+
+    Worker * w = &_workers[0];
+    w->dispatcher->_state = FINISHING;
+    w->running = &_main;
+    switch_context(w->dispatcher, &_main);
+}
+
+void Thread::dispatch(bool locked, bool requeue, Thread * to)
+{
+    Worker * w = worker();
+    Thread * prev = w->running;
+    int disabled = w->disabled; // cada thread retoma com a sua profundidade de seções desabilitadas.
+
+    // Quem só devolve o processador pode não trocar de contexto (abaixo): os prazos vencidos são verificados antes.
+    if (requeue)
+        check_events(locked);
+
+    // Troca direta: se já houver uma thread pronta, troca para ela sem passar pelo despachante,
+    // que só é necessário quando não há nenhuma (espera ocupada e término).
+    Thread * next = to;
+    if (next)
+        w->running = next;
+    else if (DIRECT_SWITCH)
+        next = get_thread_to_dispatch_ready();
+    if (!next)
+    {
+        // Nada mais a executar: a thread que só devolveria o processador continua.
+        if (DIRECT_SWITCH && requeue && prev->_state == RUNNING)
+        {
+            w->running = prev;
+            if (locked)
+                unlock();
+            return;
+        }
+
+        next = w->dispatcher;
+        w->running = next;
+    }
+
+    w->prev = prev;
+    w->locked = locked;
+    w->requeue = requeue;
+
+    // Troque o contexto entre as threads;
+    db<Thread>(TRC) << "\nTHREAD " << prev->_id << " TEVE SEU CONTEXTO TROCADO PARA " << next->_id << ".\n";
+
+    if (Trace::ENABLED)
+        Trace::record(w->id, Trace::SWITCH, prev->_id, next->_id);
+    if (STATS)
+        switched(w, prev, next);
+    CPU::switch_context(prev->context(), next->context());
+
+    // De volta, possivelmente em outro worker: conclui a troca feita pela thread que liberou o processador.
+    w = worker();
+    complete_switch(w);
+    w->disabled = disabled;
 }
 
 void Thread::yield()
@@ -122,151 +690,522 @@ void Thread::yield()
     // Imprima informação usando o debug em nível TRC;
     db<Thread>(TRC) << "Yield Chamado"; // Imprime a thread que está executando.
 
-    // Escolha uma próxima thread a ser executada;
-    // Como o Dispacher não chama o yield, ele não é rankeado novamente, então sua prioridade sempre será a maior.
-    // Logo, next aponta ao Dispacher. E este, portanto, dispara a próxima thread a ser executada.
-    Thread * next = _ready.remove()->object();
-    Thread * prev = _running;
+    int_disable();
+    trace(Trace::YIELD);
 
-    // Atualiza a prioridade da tarefa que estava sendo executada (aquela que chamou yield) com o
-    // timestamp atual, a fim de reinserí-la na fila de prontos atualizada (cuide de casos especiais, como
-    // estado ser FINISHING ou Thread main que não devem ter suas prioridades alteradas);
-    if (_running != &_main && _running->_state != FINISHING && _running->_state != SUSPEND && _running->_state != WAITING)
+    // A main não volta para a fila de prontos (cuide de casos especiais).
+    if (running() == &_main)
     {
-        _running->_link.rank(get_now_timestamp()); // Atualiza a prioridade da thread que estava executando.
-        db<Thread>(TRC) << "\nTHREAD " << _running->_id << " RANKEADA COM NOW TIMESTAMP = " << _running->_link.rank() << ".\n";
+        lock();
+        _runnable--;
+        dispatch();
+    }
+    else
+    {
+        // Sem a trava: a thread é reinserida na fila de prontos por quem receber o processador, depois que seu contexto for salvo.
+        dispatch(false, true);
+    }
 
-        // Reinsira a thread que estava executando na fila de prontos;
-        _running->_state = READY;
-        _ready.insert(&_running->_link);
-        db<Thread>(TRC) << "\nTHREAD " << _running->_id << " REINSERIDA NA FILA DE PRONTAS.\n";
+    int_enable();
+}
+
+void Thread::preempt()
+{
+    db<Thread>(TRC) << "FIM DO QUANTUM.\n";
+
+    // Como um yield(), mas a main também volta para a fila de prontos.
+    int_disable();
+    Worker * w = worker();
+    w->pending = false;
+    trace(Trace::YIELD, 1); // involuntário.
+    if (STATS)
+    {
+        w->preemptions++;
+        w->preempted = true;
     }
+    dispatch(false, true);
+    worker()->preempted = false; // sem troca, switched() não o consumiu.
+    int_enable();
+}
 
-    // Atualiza o ponteiro _running;
-    _running = next;
+// Nem toda glibc define sigev_notify_thread_id, o nome documentado em sigevent(7): sem ele, o campo só
+// existe com o nome interno.
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
 
-    // Atualiza o estado da próxima thread a ser executada;
-    next->_state = RUNNING;
+void Thread::start_timer(Worker * w)
+{
+    // O sinal é entregue à thread do kernel do próprio worker.
+    struct sigevent event = {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGALRM;
+    event.sigev_notify_thread_id = gettid();
+    if (timer_create(CLOCK_MONOTONIC, &event, &w->timer) < 0)
+    {
+        db<Thread>(ERR) << "Thread::start_timer: timer_create falhou.\n";
+        return;
+    }
 
-    // Troque o contexto entre as threads;
-    db<Thread>(TRC) << "\nTHREAD " << prev->_id << " TEVE SEU CONTEXTO TROCADO PARA " << next->_id << ".\n";
+    struct itimerspec quantum = {};
+    quantum.it_value.tv_sec = Traits<Thread>::quantum / 1000000;
+    quantum.it_value.tv_nsec = (Traits<Thread>::quantum % 1000000) * 1000;
+    quantum.it_interval = quantum.it_value;
+    timer_settime(w->timer, 0, &quantum, 0);
+}
+
+NO_PREEMPTION void Thread::timer_handler(int, siginfo_t *, void * context)
+{
+    Worker * w = current_worker();
 
-    switch_context(prev, next);
+    // O despachante nunca é preemptado: ele só executa enquanto não há threads prontas.
+    // Sinais ainda pendentes quando os workers param são ignorados.
+    if (w->running == w->dispatcher || _stopping)
+        return;
+
+    // Endereço da instrução interrompida.
+    ucontext_t * uc = reinterpret_cast<ucontext_t *>(context);
+#if defined(__x86_64__)
+    char * pc = reinterpret_cast<char *>(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+    char * pc = reinterpret_cast<char *>(uc->uc_mcontext.pc);
+#else
+    char * pc = 0;
+#endif
+
+    // Dentro de uma seção com interrupções desabilitadas, a troca é adiada para int_enable().
+    if (w->disabled || (pc >= __start_thread_nopreempt && pc < __stop_thread_nopreempt))
+    {
+        w->pending = true;
+        return;
+    }
+
+    // SA_NODEFER: o sinal não fica bloqueado na thread do kernel enquanto outra Thread executa sobre este quadro.
+    // Um sinal aninhado antes do incremento abaixo é adiado, pois o tratador também está na seção.
+    w->disabled++;
+    preempt();
+    int_enable();
+}
+
+void Thread::reschedule()
+{
+    Thread * prev = running();
+
+    // Reinsira a thread que estava executando na fila de prontos (cuide de casos especiais, como
+    // estado ser FINISHING ou Thread main que não devem voltar à fila);
+    // Uma thread suspensa por outro worker enquanto executava vai para a fila de suspensas.
+    bool requeue = prev != &_main && prev->_state != FINISHING && prev->_state != WAITING;
+
+    // Escolha uma próxima thread a ser executada: o despachante do worker é quem a escolhe.
+    dispatch(true, requeue);
 }
 
 void Thread::insert_thread_link_on_ready_queue(Thread* thread)
 {
-    if (thread->_id != _main._id)
+    if (SMP)
     {
-        _ready.insert(&thread->_link);
+        // A thread é inserida na fila do worker atual; os demais a roubam se ficarem sem trabalho.
+        __sync_fetch_and_add(&thread->_entries, 1);
+        worker()->ready.push(thread);
+        ready_pushed();
     }
+    else
+        _ready.insert(&thread->_link);
 }
 
 int Thread::join()
 {
-    if (_running == this)
+    return join_until(0);
+}
+
+int Thread::join(const Microsecond & timeout)
+{
+    // Com prazo já vencido, apenas verifica se a thread terminou.
+    return join_until(now() + (timeout > 0 ? timeout : 0) + 1);
+}
+
+int Thread::join_until(const Microsecond & deadline)
+{
+    int_disable();
+    lock();
+
+    Thread * running = Thread::running();
+    if (running == this)
     {
+        unlock();
+        int_enable();
         db<Thread>(TRC) << "Thread::join() CHAMADO PELA PRÓPRIA THREAD.\n";
         return -1;
     }
 
     if (this->_state != FINISHING)
     {
-        _waiting = _running;
-        _running->suspend();
+        // Dorme até que esta termine (ver thread_exit()) ou o prazo expire.
+        if (!running->sleep(&_joining, deadline))
+        {
+            int_enable();
+            return -1;
+        }
     }
+    else
+        unlock();
+
+    int_enable();
+
     return _exit_code;
 }
 
 void Thread::resume()
+{
+    int_disable();
+    lock();
+    resume_locked();
+    unlock();
+    int_enable();
+}
+
+void Thread::resume_locked()
 {
     if (this->_state == SUSPEND)
     {
-        _suspended.remove(&_link);
+        unmark_idle();
+        _runnable++;
+
+        // Se ainda não saiu do processador (suspensa por outro worker), basta cancelar a suspensão.
+        if (!_suspended.remove(this))
+        {
+            this->_state = RUNNING;
+            return;
+        }
+
         this->_state = READY;
-        _ready.insert(&_link);
+        if (STATS_TIME)
+            account(READY, Trace::tsc());
+        insert_thread_link_on_ready_queue(this);
     }
 }
 
 void Thread::suspend()
 {
-    // Seta o estado da thread como SUSPEND.
-    _state = SUSPEND;
+    int_disable();
+    lock();
 
-    _suspended.insert(&_link); // Insere a thread na fila de suspensas.
-
-    if (_running != this)
+    if (running() == this)
     {
-        _ready.remove(&_link); // Remove a thread da fila de prontos.
+        // Seta o estado da thread como SUSPEND.
+        if (runnable())
+            _runnable--;
+        _state = SUSPEND;
+
+        _suspended.insert(&_link); // Insere a thread na fila de suspensas.
+        mark_idle();
+        dispatch();
+        int_enable();
+        return;
     }
-    else
+
+    // Com SMP, outros workers mudam o estado entre READY e RUNNING sem a trava (despacho e yield).
+    while (runnable())
     {
-        yield();
+        if (_state == READY && remove_from_ready(SUSPEND)) // Remove a thread da fila de prontos.
+        {
+            if (STATS_TIME)
+                account(SUSPEND, Trace::tsc());
+            _runnable--;
+            _suspended.insert(&_link); // Insere a thread na fila de suspensas.
+            mark_idle();
+        }
+        else if (_state == RUNNING && claim(RUNNING, SUSPEND))
+        {
+            // Executando em outro worker: ela entra na fila de suspensas quando devolver o processador.
+            _runnable--;
+        }
     }
+
+    unlock();
+    int_enable();
 }
 
-void Thread::sleep(Asleep_Queue* sleepQueue)
+bool Thread::sleep(Asleep_Queue* sleepQueue, const Microsecond & deadline)
 {
-    if (!_asleep)
-    {
-        _asleep = sleepQueue;
-    }
+    _asleep = sleepQueue;
 
-    sleepQueue->insert(&_link);
+    if (sleepQueue)
+        sleepQueue->insert(&_link);
+
+    _timed_out = false;
+    if (deadline)
+        _timers.insert(&_alarm, deadline);
 
     db<Thread>(TRC) << "Thread::sleep() CHAMADO.\n";
-    _state = WAITING;
-    if (_running != this)
+    trace(Trace::SLEEP, this, deadline);
+    if (runnable())
+        _runnable--;
+    if (running() != this)
     {
-        _ready.remove(&_link);
+        if (_state != READY || !remove_from_ready(WAITING))
+            _state = WAITING;
+        if (STATS_TIME)
+            account(WAITING, Trace::tsc());
+        mark_idle();
+        unlock();
+        return true;
     }
-    else
+
+    _state = WAITING;
+    mark_idle();
+    dispatch();
+
+    return !_timed_out;
+}
+
+void Thread::sleep_for(const Microsecond & duration)
+{
+    sleep_until(now() + duration);
+}
+
+void Thread::sleep_until(const Microsecond & deadline)
+{
+    int_disable();
+
+    // Prazo já vencido: apenas devolve o processador (inclusive a main, que continua pronta).
+    if (deadline <= now())
     {
-        yield();
+        dispatch(false, true);
+        int_enable();
+        return;
     }
+
+    lock();
+    running()->sleep(0, deadline);
+    int_enable();
+}
+
+void Thread::offload(void (* run)(void *), void * object)
+{
+    db<Thread>(TRC) << "Thread::offload() CHAMADO.\n";
+
+    Helper_Pool::Call call(run, object);
+    Helper_Pool::execute(&call);
 }
 
 void Thread::wakeup(bool reschedule)
 {
     db<Thread>(TRC) << "Thread::wakeup() CHAMADO.\n";
+    wake();
+
+    if (reschedule)
+        handoff();
+    else
+        unlock();
+}
+
+void Thread::handoff()
+{
+    // A thread acordada executa já, à frente das que estão na fila de prontos, e quem a acordou volta para a
+    // fila (inclusive a main, como em preempt()). Assim o que lhe foi entregue (ex.: o semáforo, em v())
+    // é usado de imediato, sem outras threads intercaladas e sem passar pelo despachante.
+    // Se outro worker já a despachou, apenas segue.
+    Thread * prev = running();
+    if (prev->_state == RUNNING && remove_from_ready(RUNNING))
+        dispatch(true, true, this);
+    else
+        unlock();
+}
+
+void Thread::wake()
+{
+    trace(Trace::WAKEUP, this, 0);
+    _timers.remove(&_alarm);
+    unmark_idle();
+    _asleep = nullptr;
+    if (!runnable())
+        _runnable++;
     _state = READY;
+    if (STATS_TIME)
+        account(READY, Trace::tsc());
     _link.rank(get_now_timestamp());
-    _ready.insert(&_link);
+    insert_thread_link_on_ready_queue(this);
+}
 
-    if (reschedule)
-        yield();
+void Thread::timeout()
+{
+    db<Thread>(TRC) << "PRAZO DA THREAD " << _id << " EXPIRADO.\n";
+
+    if (_asleep)
+        _asleep->remove(&_link);
+    if (_select)
+        _select->withdraw(Select::NONE);
+    _timed_out = true;
+    wake();
+}
+
+void Thread::expire_timers()
+{
+    if (_timers.empty())
+        return;
+
+    for (Timer_Wheel::Element * e = _timers.expire(now()); e; )
+    {
+        Timer_Wheel::Element * next = e->next();
+        e->object()->timeout();
+        e = next;
+    }
+}
+
+void Thread::check_events(bool locked)
+{
+    // Leitura sem a trava: no máximo atrasa a expiração até a próxima verificação.
+    if (!_timers.empty())
+    {
+        if (locked)
+            expire_timers();
+        else if (try_lock())
+        {
+            expire_timers();
+            unlock();
+        }
+    }
+
+    // Threads esperando descritores: consulta o epoll de tempos em tempos mesmo com threads prontas.
+    if (!locked && IO::waiting())
+        IO::check();
 }
 
 void Thread::thread_exit(int exit_code)
 {
     db<Thread>(INF) << "THREAD " << this->_id << " DELETADA.\n";
+    int_disable();
+    lock();
     _numOfThreads--; // Decrementa o número de threads criadas.
     _released_ids.push(this->_id); // Coloca o id da thread que está sendo encerrada na fila de ids liberados.
+    if (runnable())
+        _runnable--;
     this->_state = FINISHING; // Seta o estado da thread como finalizando.
     this->_exit_code = exit_code; // Seta o código de término da thread.
+    trace(Trace::EXIT, this, exit_code);
+
+    // Relatório de pico de uso da pilha, para dimensionar Configuration::stack_size.
+    if (Stack_Pool::PAINT)
+        db<Thread>(INF) << "THREAD " << this->_id << ": PILHA " << stack_usage() << "/" << stack_size() << " BYTES USADOS.\n";
+
+    // A pilha só pode ser liberada depois que a thread sair dela, na próxima troca de contexto.
+    // A pilha da main é mantida, pois o despachante volta para ela ao final.
+    if (this != &_main)
+        _finished.insert_tail(&_link);
+
+    // Acorda as threads que esperam a execução desta thread terminar.
+    while (!_joining.empty())
+        _joining.remove()->object()->wake();
+
+    dispatch(); // Libera o processador para outra thread(DISPACHER).
 
-    // Se houver uma thread suspensa por estar esperando a execução desta thread terminar, a libera.
-    if (_waiting)
+    // Só a main volta para cá, ao final, pelo despachante do worker 0, com os demais workers já parados.
+    if (Trace::ENABLED && Traits<Trace>::file)
+        Trace::dump(Traits<Trace>::file);
+
+    int_enable();
+}
+
+void Thread::release_finished_threads()
+{
+    while (!_finished.empty())
     {
-        _waiting->resume();
-        _waiting = nullptr;
+        Thread * finished = _finished.remove()->object();
+        db<Thread>(TRC) << "PILHA DA THREAD " << finished->_id << " DEVOLVIDA AO POOL.\n";
+        delete finished->_context;
+        finished->_context = 0;
     }
+}
 
-    yield(); // Libera o processador para outra thread(DISPACHER).
+void Thread::mark_idle()
+{
+    if (!Stack_Pool::LAZY || _idle_since)
+        return;
+
+    _idle_since = get_now_timestamp();
+    if (!_idle_since)
+        _idle_since = 1;
+    _idle.insert_tail(&_idle_link);
+}
+
+void Thread::unmark_idle()
+{
+    if (!_idle_since)
+        return;
+
+    _idle.remove(&_idle_link);
+    _idle_since = 0;
+}
+
+void Thread::trim_idle_stacks()
+{
+    if (_idle.empty())
+        return;
+
+    unsigned int now = get_now_timestamp();
+    while (!_idle.empty())
+    {
+        Thread * idle = _idle.head()->object();
+        if (now - (unsigned int)idle->_idle_since < (unsigned int)Traits<Stack_Pool>::trim_delay)
+            break;
+
+        db<Thread>(TRC) << "PILHA DA THREAD " << idle->_id << " APARADA.\n";
+        idle->unmark_idle();
+        if (idle->_context)
+            idle->_context->trim();
+    }
 }
 
 Thread::~Thread()
 {
-    if (_asleep)
+    int_disable();
+    lock();
+
+    unmark_idle();
+
+    // Só as threads criadas (não as estáticas nunca iniciadas) estão em _threads.
+    if (STATS && _since)
+        _threads.remove(&_thread_link);
+
+    // Remove a thread da fila em que ela estiver, de acordo com seu estado.
+    switch (_state)
     {
-        _asleep->remove(&_link);
+    case READY:
+        if (remove_from_ready(FINISHING))
+            _runnable--;
+        break;
+    case SUSPEND:
+        _suspended.remove(&this->_link);
+        break;
+    case WAITING:
+        if (_asleep)
+            _asleep->remove(&_link);
+        _timers.remove(&_alarm);
+        break;
+    case FINISHING:
+        _finished.remove(this);
+        break;
+    default:
+        break;
     }
 
-    _ready.remove(&this->_link); // Remove a thread da fila de prontos.
-    if (this->_context) // Libera o contexto, caso ele exista.
+    // Libera o contexto, caso ele exista. A thread em execução não pode liberar a pilha em que está
+    // (ex.: destrutor estático da main, chamado pelo exit() ao final da main).
+    bool running = (this == Thread::running());
+
+    unlock();
+
+    // Com SMP, a thread ainda pode ser referenciada nas filas dos workers.
+    if (SMP && _entries)
+        drop_entries();
+
+    if (this->_context && !running)
     {
         delete this->_context;
     }
+
+    int_enable();
 }
 
 __END_API
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "Concurrency/trace.h"
+
+__BEGIN_API
+
+Trace::Ring Trace::_rings[WORKERS];
+Trace::Record Trace::_buffers[WORKERS][ENTRIES];
+unsigned long long Trace::_tsc0 = 0;
+unsigned long long Trace::_ns0 = 0;
+
+unsigned long long Trace::nanoseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void Trace::init()
+{
+    _tsc0 = tsc();
+    _ns0 = nanoseconds();
+}
+
+double Trace::ticks_per_us()
+{
+    // Sem calibração (ou sem tempo decorrido), o contador já está em nanossegundos.
+    unsigned long long tsc1 = tsc(), ns1 = nanoseconds();
+    if (_ns0 && ns1 > _ns0 && tsc1 > _tsc0)
+        return double(tsc1 - _tsc0) * 1000 / (ns1 - _ns0);
+    return 1000;
+}
+
+bool Trace::dump(const char * path)
+{
+    static const char * names[EVENTS] = { "create", "exit", "switch", "yield", "sleep", "wakeup", "p", "v" };
+
+    FILE * f = fopen(path, "w");
+    if (!f)
+        return false;
+
+    double per_us = ticks_per_us();
+
+    // Os eventos de cada worker, do mais antigo ao mais recente.
+    std::vector<Record> events;
+    for (unsigned int w = 0; w < WORKERS; w++)
+    {
+        unsigned long head = _rings[w].head;
+        unsigned long first = head > ENTRIES ? head - ENTRIES : 0;
+        for (unsigned long i = first; i < head; i++)
+            events.push_back(_buffers[w][i & (ENTRIES - 1)]);
+    }
+    if (events.empty())
+    {
+        fprintf(f, "{\"traceEvents\": []}\n");
+        fclose(f);
+        return true;
+    }
+
+    unsigned long long origin = events[0].time;
+    for (unsigned int i = 1; i < events.size(); i++)
+        origin = std::min(origin, events[i].time);
+
+    fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    for (unsigned int w = 0; w < WORKERS; w++)
+        fprintf(f, "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %u, \"args\": {\"name\": \"worker %u\"}},\n", w, w);
+
+    // Cada troca de contexto fecha o intervalo da thread que executava no worker desde a troca anterior.
+    std::vector<long long> since(WORKERS, -1);
+    std::vector<long> running(WORKERS, -1);
+    for (unsigned int i = 0; i < events.size(); i++)
+    {
+        const Record & e = events[i];
+        double ts = (e.time - origin) / per_us;
+        if (e.event == SWITCH)
+        {
+            if (since[e.worker] >= 0 && running[e.worker] == e.thread)
+            {
+                double start = (since[e.worker] - origin) / per_us;
+                fprintf(f, "{\"name\": \"thread %d\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f},\n",
+                        e.thread, e.worker, start, ts - start);
+            }
+            since[e.worker] = e.time;
+            running[e.worker] = e.arg;
+        }
+        fprintf(f, "{\"name\": \"%s\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"args\": {\"thread\": %d, \"arg\": %ld}}%s\n",
+                e.event < EVENTS ? names[e.event] : "?", e.worker, ts, e.thread, e.arg, i + 1 < events.size() ? "," : "");
+    }
+    fprintf(f, "]}\n");
+
+    fclose(f);
+    return true;
+}
+
+__END_API
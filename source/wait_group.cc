@@ -0,0 +1,48 @@
+#include "Concurrency/debug.h"
+#include "Concurrency/traits.h"
+
+#include "Concurrency/wait_group.h"
+
+__BEGIN_API
+
+void Wait_Group::add(int n)
+{
+    int count = __atomic_add_fetch(&_count, n, __ATOMIC_ACQ_REL);
+    if (count > 0)
+        return;
+    if (count < 0)
+        db<Wait_Group>(WRN) << "Wait_Group: done() sem add() correspondente.\n";
+
+    // Zerou (ou ficou negativo, que wait() também trata como concluído): acorda todas de uma vez, sem ceder
+    // o processador.
+    Thread::int_disable();
+    Thread::lock();
+    while (!_asleep.empty())
+        _asleep.remove()->object()->wake();
+    Thread::unlock();
+    Thread::int_enable();
+}
+
+void Wait_Group::wait()
+{
+    db<Wait_Group>(TRC) << "Wait_Group::wait called." << "\n";
+    if (__atomic_load_n(&_count, __ATOMIC_ACQUIRE) <= 0)
+        return;
+
+    // A verificação com a trava ordena a inserção em _asleep e o acordar de add().
+    Thread::int_disable();
+    Thread::lock();
+    if (_count > 0)
+        Thread::running()->sleep(&_asleep);
+    else
+        Thread::unlock();
+    Thread::int_enable();
+}
+
+Wait_Group::~Wait_Group()
+{
+    if (!_asleep.empty())
+        db<Wait_Group>(WRN) << "Wait_Group destruído com threads esperando.\n";
+}
+
+__END_API
@@ -0,0 +1,420 @@
+/*
+ * Teste de carga e de longa duração (soak) do escalonador.
+ *
+ * Uso: stress [--pattern=P] [--threads=N] [--live=L] [--rounds=R] [--duration=S] [--stack=B] [--timeout=U]
+ *   pattern   fanout (padrão): cria N threads, no máximo L vivas ao mesmo tempo, e espera todas (Wait_Group).
+ *             pipeline: N threads em cadeia, ligadas por Channels, repassando --items valores.
+ *             semaphore: N threads disputando --semaphores semáforos, com yield dentro da seção crítica; com
+ *             --timeout=U, metade delas usa p() com prazo de U microssegundos (e desiste ao expirar). Cada entrada
+ *             confere a exclusão mútua: com mais de um worker ou preempção, exercita as desistências concorrentes
+ *             com v() (ver Semaphore::cancel()).
+ *             churn: N threads dormindo e acordando (sleep_for) --iterations vezes cada.
+ *             latch: N threads esperando um Latch(2) e um Wait_Group com add(1), liberadas por um único
+ *             count_down(3) e por dois done(): os contadores passam de zero direto para negativo. Se as esperas
+ *             não forem acordadas, a rodada não termina e nenhuma linha é escrita para ela.
+ *   threads   threads por rodada (padrão 10000).
+ *   live      threads vivas ao mesmo tempo no fanout (padrão: todas).
+ *   rounds    rodadas (padrão 1); com duration, repete até completar S segundos (soak).
+ *   stack     tamanho da pilha de cada thread, em bytes (padrão: Stack_Pool::STACK_SIZE).
+ *
+ * Cada rodada escreve uma linha JSON com a memória residente (atual e pico), a taxa de criação de threads,
+ * a vazão (operações do padrão por segundo), o maior id de thread atribuído até então e quantas threads
+ * receberam o id de outra ainda viva, além de quantas vezes duas threads estiveram juntas na seção crítica de
+ * um semáforo (sempre 0). Um RSS que cresce de rodada em rodada indica vazamento.
+ * Cada pilha usa dois mapeamentos: mais de ~30 mil threads vivas exigem aumentar vm.max_map_count.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <string>
+#include <vector>
+
+#include "Concurrency/system.h"
+#include "Concurrency/thread.h"
+#include "Concurrency/semaphore.h"
+#include "Concurrency/wait_group.h"
+#include "Concurrency/channel.h"
+#include "Concurrency/latch.h"
+
+__USING_API
+
+enum Pattern { FANOUT, PIPELINE, SEMAPHORE, CHURN, LATCH };
+
+static Pattern pattern = FANOUT;
+static int threads = 10000;
+static int live = 0;
+static int rounds = 1;
+static long duration = 0;
+static unsigned int stack = Stack_Pool::STACK_SIZE;
+static int items = 100;
+static int semaphores = 16;
+static int iterations = 10;
+static long timeout = 0;
+
+static long long now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long rss_kb()
+{
+    long pages = 0;
+    FILE * f = fopen("/proc/self/statm", "r");
+    if (f)
+    {
+        if (fscanf(f, "%*d %ld", &pages) != 1)
+            pages = 0;
+        fclose(f);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static long peak_rss_kb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Ids das threads vivas, para detectar um id atribuído a duas threads ao mesmo tempo.
+static std::vector<char> alive;
+static volatile int max_id = 0;
+static volatile long duplicates = 0;
+static volatile long long operations = 0;
+static volatile long violations = 0;
+
+static void enter()
+{
+    int id = Thread::running()->id();
+    if (id >= (int)alive.size())
+        return; // acima do esperado: aparece em max_id.
+    for (int m = max_id; id > m && !__atomic_compare_exchange_n(&max_id, &m, id, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED); )
+        ;
+    if (__atomic_exchange_n(&alive[id], 1, __ATOMIC_RELAXED))
+        __atomic_add_fetch(&duplicates, 1, __ATOMIC_RELAXED);
+}
+
+static void leave()
+{
+    int id = Thread::running()->id();
+    if (id < (int)alive.size())
+        __atomic_store_n(&alive[id], 0, __ATOMIC_RELAXED);
+}
+
+static void count(long long n) { __atomic_add_fetch(&operations, n, __ATOMIC_RELAXED); }
+
+// fanout
+static Wait_Group * group;
+
+static void child(int)
+{
+    enter();
+    Thread::yield();
+    count(1);
+    leave();
+    group->done();
+    Thread::running()->thread_exit(0);
+}
+
+// pipeline
+typedef Channel<int, 16> Pipe;
+static std::vector<Pipe *> pipes;
+
+static void stage(int i)
+{
+    enter();
+    int value;
+    while (pipes[i]->recv(value))
+    {
+        pipes[i + 1]->send(value + 1);
+        count(1);
+    }
+    pipes[i + 1]->close();
+    leave();
+    Thread::running()->thread_exit(0);
+}
+
+// semaphore
+static std::vector<Semaphore *> locks;
+static std::vector<int> holders; // threads na seção crítica de cada semáforo.
+
+static void contender(int i)
+{
+    enter();
+    int l = i % locks.size();
+    Semaphore * s = locks[l];
+    int acquired = 0;
+    for (int k = 0; k < iterations; k++)
+    {
+        if (timeout && (i & 1))
+        {
+            if (!s->p(timeout))
+                continue;
+        }
+        else
+            s->p();
+        if (__atomic_add_fetch(&holders[l], 1, __ATOMIC_RELAXED) != 1)
+            __atomic_add_fetch(&violations, 1, __ATOMIC_RELAXED);
+        Thread::yield();
+        __atomic_sub_fetch(&holders[l], 1, __ATOMIC_RELAXED);
+        s->v();
+        acquired++;
+    }
+    count(acquired);
+    leave();
+    Thread::running()->thread_exit(0);
+}
+
+// churn
+static void sleeper(int i)
+{
+    enter();
+    unsigned int seed = i;
+    for (int k = 0; k < iterations; k++)
+    {
+        seed = seed * 1103515245 + 12345;
+        Thread::sleep_for((seed >> 16) % 1000);
+    }
+    count(iterations);
+    leave();
+    Thread::running()->thread_exit(0);
+}
+
+// latch
+static Latch * gate;
+static volatile int arrived = 0;
+
+static void waiter(int)
+{
+    enter();
+    __atomic_add_fetch(&arrived, 1, __ATOMIC_RELAXED);
+    gate->wait();
+    group->wait();
+    count(1);
+    leave();
+    Thread::running()->thread_exit(0);
+}
+
+// Cria as threads de uma rodada (acumulando o tempo de criação em created_ns).
+static Thread * spawn(void (* entry)(int), int i, long long & created_ns)
+{
+    long long t0 = now();
+    Thread * t = new Thread(Thread::Configuration(stack), entry, i);
+    created_ns += now() - t0;
+    return t;
+}
+
+static void finish(std::vector<Thread *> & list)
+{
+    for (unsigned int i = 0; i < list.size(); i++)
+    {
+        list[i]->join();
+        delete list[i];
+    }
+    list.clear();
+}
+
+static long long round_fanout()
+{
+    long long created_ns = 0;
+    int wave = live > 0 ? live : threads;
+    std::vector<Thread *> list;
+    for (int done = 0; done < threads; done += wave)
+    {
+        int n = threads - done < wave ? threads - done : wave;
+        group = new Wait_Group;
+        group->add(n);
+        for (int i = 0; i < n; i++)
+        {
+            list.push_back(spawn(&child, i, created_ns));
+            // Deixa as primeiras terminarem durante a criação: ids reaproveitados se misturam aos novos.
+            if (i % 64 == 63)
+                Thread::yield();
+        }
+        group->wait();
+        finish(list);
+        delete group;
+    }
+    return created_ns;
+}
+
+static long long round_pipeline()
+{
+    long long created_ns = 0;
+    for (int i = 0; i <= threads; i++)
+        pipes.push_back(new Pipe);
+
+    std::vector<Thread *> list;
+    for (int i = 0; i < threads; i++)
+        list.push_back(spawn(&stage, i, created_ns));
+
+    // Envia e recebe ao mesmo tempo: a cadeia inteira cabe em poucos valores por canal.
+    int sent = 0, received = 0, value;
+    while (received < items)
+    {
+        if (sent < items && pipes[0]->try_send(sent))
+            sent++;
+        else if (pipes[threads]->recv(value))
+            received++;
+        if (sent == items && !pipes[0]->closed())
+            pipes[0]->close();
+    }
+
+    finish(list);
+    for (unsigned int i = 0; i < pipes.size(); i++)
+        delete pipes[i];
+    pipes.clear();
+    return created_ns;
+}
+
+static long long round_semaphore()
+{
+    long long created_ns = 0;
+    for (int i = 0; i < semaphores; i++)
+        locks.push_back(new Semaphore(1));
+    holders.assign(semaphores, 0);
+
+    std::vector<Thread *> list;
+    for (int i = 0; i < threads; i++)
+        list.push_back(spawn(&contender, i, created_ns));
+    finish(list);
+
+    for (unsigned int i = 0; i < locks.size(); i++)
+        delete locks[i];
+    locks.clear();
+    return created_ns;
+}
+
+static long long round_churn()
+{
+    long long created_ns = 0;
+    std::vector<Thread *> list;
+    for (int i = 0; i < threads; i++)
+        list.push_back(spawn(&sleeper, i, created_ns));
+    finish(list);
+    return created_ns;
+}
+
+static long long round_latch()
+{
+    long long created_ns = 0;
+    gate = new Latch(2);
+    group = new Wait_Group;
+    group->add(1);
+    arrived = 0;
+
+    std::vector<Thread *> list;
+    for (int i = 0; i < threads; i++)
+        list.push_back(spawn(&waiter, i, created_ns));
+    // Só libera depois que todas chegaram (e, com um worker, já dormem em wait()).
+    while (__atomic_load_n(&arrived, __ATOMIC_RELAXED) < threads)
+        Thread::yield();
+
+    gate->count_down(3);
+    group->done();
+    group->done();
+    finish(list);
+
+    delete gate;
+    delete group;
+    return created_ns;
+}
+
+static const char * name(Pattern p)
+{
+    static const char * names[] = { "fanout", "pipeline", "semaphore", "churn", "latch" };
+    return names[p];
+}
+
+static void body(int)
+{
+    // Folga para a main, os despachantes e ids ainda não devolvidos.
+    alive.resize(threads + 1024, 0);
+
+    long long start = now();
+    for (int r = 0; r < rounds || (duration && now() - start < duration * 1000000000LL); r++)
+    {
+        operations = 0;
+        long long t0 = now();
+        long long created_ns = 0;
+        switch (pattern)
+        {
+        case FANOUT: created_ns = round_fanout(); break;
+        case PIPELINE: created_ns = round_pipeline(); break;
+        case SEMAPHORE: created_ns = round_semaphore(); break;
+        case CHURN: created_ns = round_churn(); break;
+        case LATCH: created_ns = round_latch(); break;
+        }
+        double seconds = (now() - t0) / 1e9;
+
+        Thread::int_disable();
+        printf("{\"round\": %d, \"pattern\": \"%s\", \"threads\": %d, \"elapsed_s\": %.3f, \"round_s\": %.3f, "
+               "\"rss_kb\": %ld, \"peak_rss_kb\": %ld, \"creations_per_s\": %.0f, \"ops_per_s\": %.0f, "
+               "\"max_id\": %d, \"duplicate_ids\": %ld, \"exclusion_violations\": %ld}\n",
+               r, name(pattern), threads, (now() - start) / 1e9, seconds, rss_kb(), peak_rss_kb(),
+               created_ns ? threads / (created_ns / 1e9) : 0.0, operations / seconds, max_id, duplicates, violations);
+        fflush(stdout);
+        Thread::int_enable();
+    }
+
+    Thread::running()->thread_exit(0);
+}
+
+// A main não volta para a fila de prontos em yield(): a carga executa em outra thread.
+static void stress_main(void *)
+{
+    Thread * t = new Thread(&body, 0);
+    t->join();
+    delete t;
+    Thread::running()->thread_exit(0);
+}
+
+static bool option(const char * arg, const char * key, const char ** value)
+{
+    size_t n = strlen(key);
+    if (strncmp(arg, key, n) || arg[n] != '=')
+        return false;
+    *value = arg + n + 1;
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char * v;
+        if (option(argv[i], "--pattern", &v))
+        {
+            if (!strcmp(v, "fanout")) pattern = FANOUT;
+            else if (!strcmp(v, "pipeline")) pattern = PIPELINE;
+            else if (!strcmp(v, "semaphore")) pattern = SEMAPHORE;
+            else if (!strcmp(v, "churn")) pattern = CHURN;
+            else if (!strcmp(v, "latch")) pattern = LATCH;
+            else { fprintf(stderr, "padrão desconhecido: %s\n", v); return 1; }
+        }
+        else if (option(argv[i], "--threads", &v)) threads = atoi(v);
+        else if (option(argv[i], "--live", &v)) live = atoi(v);
+        else if (option(argv[i], "--rounds", &v)) rounds = atoi(v);
+        else if (option(argv[i], "--duration", &v)) duration = atol(v);
+        else if (option(argv[i], "--stack", &v)) stack = atoi(v);
+        else if (option(argv[i], "--items", &v)) items = atoi(v);
+        else if (option(argv[i], "--semaphores", &v)) semaphores = atoi(v);
+        else if (option(argv[i], "--iterations", &v)) iterations = atoi(v);
+        else if (option(argv[i], "--timeout", &v)) timeout = atol(v);
+        else { fprintf(stderr, "opção desconhecida: %s\n", argv[i]); return 1; }
+    }
+    if (threads < 1 || semaphores < 1)
+    {
+        fprintf(stderr, "--threads e --semaphores devem ser positivos\n");
+        return 1;
+    }
+
+    System::init(&stress_main);
+    return 0;
+}